@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "utility.h"
+#include "front/front.h"
+
+// Lexing throughput on generated sources. Build with
+// -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+//
+//   lex_bench [megabytes]
+//
+// The small input stays under the lexer's parallel threshold, so it
+// measures a single thread. The large one, 128MB unless given, is split
+// across threads the way lex_source does for real files.
+
+#define SERIAL_SIZE ((size_t)3 * 1024 * 1024)
+#define SERIAL_TOTAL ((size_t)1024 * 1024 * 1024)
+#define PARALLEL_RUNS 8
+
+static const char* names[] = {
+  "counter", "value", "n", "total_sum", "x1", "index_of_item", "tmp", "accumulator_2",
+};
+
+static const char* lines[] = {
+  "%s%s: int;\n",
+  "%s%s = %s + %d * %s;\n",
+  "%s%s = %s - %s / %d; // keep the remainder out of it\n",
+  "%swhile %s {\n",
+  "%sif %s {\n",
+  "%s}\n",
+  "%s// %s is reset every time the loop around it comes back to the top\n",
+  "%sreturn %s;\n",
+};
+
+static uint32_t next_random(uint32_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Plausible source text, it only has to lex.
+static char* generate_source(size_t length) {
+  char* source = malloc(length + 1);
+  size_t at = 0;
+
+  uint32_t state = 0x2545f491;
+
+  while (true) {
+    char line[256];
+
+    const char* indent = "        " + (next_random(&state) % 4) * 2;
+    const char* a = names[next_random(&state) % ARRAY_LENGTH(names)];
+    const char* b = names[next_random(&state) % ARRAY_LENGTH(names)];
+    const char* c = names[next_random(&state) % ARRAY_LENGTH(names)];
+    int number = (int)(next_random(&state) % 100000);
+
+    switch (next_random(&state) % ARRAY_LENGTH(lines)) {
+      case 0: snprintf(line, sizeof(line), lines[0], indent, a); break;
+      case 1: snprintf(line, sizeof(line), lines[1], indent, a, b, number, c); break;
+      case 2: snprintf(line, sizeof(line), lines[2], indent, a, b, c, number); break;
+      case 3: snprintf(line, sizeof(line), lines[3], indent, a); break;
+      case 4: snprintf(line, sizeof(line), lines[4], indent, a); break;
+      case 5: snprintf(line, sizeof(line), lines[5], indent); break;
+      case 6: snprintf(line, sizeof(line), lines[6], indent, a); break;
+      default: snprintf(line, sizeof(line), lines[7], indent, a); break;
+    }
+
+    size_t line_length = strlen(line);
+
+    if (at + line_length > length) {
+      break;
+    }
+
+    memcpy(source + at, line, line_length);
+    at += line_length;
+  }
+
+  memset(source + at, '\n', length - at);
+  source[length] = '\0';
+
+  return source;
+}
+
+static double now_seconds() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Best time of 'runs' lexes of the whole source.
+static double time_lex(const char* source, size_t length, int runs) {
+  double best = 0.0;
+
+  for (int i = 0; i < runs; ++i) {
+    Arena* arena = new_arena();
+    Interner* interner = new_interner();
+
+    double start = now_seconds();
+    Tokens tokens = lex_source(arena, interner, "bench", source, length);
+    double elapsed = now_seconds() - start;
+
+    if (!tokens.data) {
+      fprintf(stderr, "lex_bench: the generated source failed to lex\n");
+      exit(1);
+    }
+
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+
+    free_interner(interner);
+    free_arena(arena);
+  }
+
+  return best;
+}
+
+static void report(const char* label, size_t length, double seconds) {
+  printf("%-9s %8.1f MB  %6.3f ms  %6.2f GB/s\n", label, (double)length / 1e6, seconds * 1e3, (double)length / seconds / 1e9);
+}
+
+int main(int argc, char** argv) {
+  init_thread();
+
+  size_t parallel_size = (size_t)128 * 1024 * 1024;
+
+  if (argc > 1) {
+    parallel_size = (size_t)strtoull(argv[1], NULL, 10) * 1024 * 1024;
+  }
+
+  char* serial = generate_source(SERIAL_SIZE);
+  report("serial", SERIAL_SIZE, time_lex(serial, SERIAL_SIZE, (int)(SERIAL_TOTAL / SERIAL_SIZE)));
+  free(serial);
+
+  if (parallel_size > SERIAL_SIZE) {
+    char* parallel = generate_source(parallel_size);
+    report("parallel", parallel_size, time_lex(parallel, parallel_size, PARALLEL_RUNS));
+    free(parallel);
+  }
+
+  cleanup_thread();
+
+  return 0;
+}
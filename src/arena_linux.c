@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "utility.h"
+
+#define ARENA_CAPACITY ((size_t)8 * 1024 * 1024 * 1024)
+
+// Commits start small and double every time the arena grows, so a large
+// token or node array costs a handful of mprotect calls instead of one per page.
+#define ARENA_MIN_COMMIT ((size_t)64 * 1024)
+#define ARENA_MAX_COMMIT ((size_t)64 * 1024 * 1024)
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// Build with -DARENA_HUGE_PAGES=1 to back arenas with transparent huge pages.
+#ifndef ARENA_HUGE_PAGES
+#define ARENA_HUGE_PAGES 0
+#endif
+
+struct Arena {
+  void* base;
+
+  size_t allocated;
+  size_t committed;
+  size_t reserved;
+
+  size_t commit_chunk;
+  size_t page_size;
+};
+
+struct ScratchImpl {
+  size_t save;
+};
+
+static thread_local Arena* scratch_arenas[2];
+
+static ArenaDecommitPolicy decommit_policy = {
+  .high_water = (size_t)256 * 1024 * 1024,
+  .retain = (size_t)16 * 1024 * 1024
+};
+
+static size_t align_up(size_t x, size_t align) {
+  return (x + align - 1) & ~(align - 1);
+}
+
+static size_t min_commit_chunk() {
+  return ARENA_HUGE_PAGES ? HUGE_PAGE_SIZE : ARENA_MIN_COMMIT;
+}
+
+Arena* new_arena() {
+  Arena* arena = calloc(1, sizeof(Arena));
+
+  arena->page_size = (size_t)sysconf(_SC_PAGESIZE);
+  arena->commit_chunk = min_commit_chunk();
+
+  size_t reserve_size = align_up(ARENA_CAPACITY, arena->page_size);
+
+  if (ARENA_HUGE_PAGES) {
+    // Over-reserve so the base can be aligned to a huge page boundary.
+    reserve_size += HUGE_PAGE_SIZE;
+  }
+
+  void* base = mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "Failed to reserve virtual address space for arena.\n");
+    exit(1);
+  }
+
+  arena->base = base;
+  arena->reserved = reserve_size;
+
+  if (ARENA_HUGE_PAGES) {
+    uintptr_t aligned = align_up((uintptr_t)base, HUGE_PAGE_SIZE);
+    size_t head = aligned - (uintptr_t)base;
+
+    if (head) {
+      munmap(base, head);
+    }
+
+    munmap((void*)(aligned + ARENA_CAPACITY), HUGE_PAGE_SIZE - head);
+
+    arena->base = (void*)aligned;
+    arena->reserved = ARENA_CAPACITY;
+
+    madvise(arena->base, arena->reserved, MADV_HUGEPAGE);
+  }
+
+  return arena;
+}
+
+void free_arena(Arena* arena) {
+  munmap(arena->base, arena->reserved);
+  free(arena);
+}
+
+static void arena_commit(Arena* arena, size_t required) {
+  if (required > arena->reserved) {
+    fprintf(stderr, "Arena address space exhausted.\n");
+    exit(1);
+  }
+
+  size_t target = align_up(required, arena->page_size);
+
+  if (target - arena->committed < arena->commit_chunk) {
+    target = arena->committed + arena->commit_chunk;
+  }
+
+  if (target > arena->reserved) {
+    target = arena->reserved;
+  }
+
+  void* start = ptr_byte_add(arena->base, arena->committed);
+
+  if (mprotect(start, target - arena->committed, PROT_READ | PROT_WRITE) != 0) {
+    fprintf(stderr, "Failed to commit arena memory.\n");
+    exit(1);
+  }
+
+  arena->committed = target;
+
+  if (arena->commit_chunk < ARENA_MAX_COMMIT) {
+    arena->commit_chunk *= 2;
+  }
+}
+
+void* arena_push(Arena* arena, size_t amount) {
+  if (amount == 0) {
+    return NULL;
+  }
+
+  size_t offset = (arena->allocated + 7) & (~7);
+
+  if (arena->committed - offset < amount) {
+    arena_commit(arena, offset + amount);
+  }
+
+  void* ptr = ptr_byte_add(arena->base, offset);
+  arena->allocated = offset + amount;
+
+  return ptr;
+}
+
+void* arena_zeroed(Arena* arena, size_t amount) {
+  void* ptr = arena_push(arena, amount);
+  memset(ptr, 0, amount);
+  return ptr;
+}
+
+bool arena_resize(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+  if (ptr_byte_add(ptr, old_size) != ptr_byte_add(arena->base, arena->allocated)) {
+    return false;
+  }
+
+  size_t offset = arena->allocated - old_size;
+
+  if (arena->committed - offset < new_size) {
+    arena_commit(arena, offset + new_size);
+  }
+
+  arena->allocated = offset + new_size;
+
+  return true;
+}
+
+void arena_trim(Arena* arena, size_t keep_bytes) {
+  if (keep_bytes < arena->allocated) {
+    keep_bytes = arena->allocated;
+  }
+
+  size_t keep = align_up(keep_bytes, ARENA_HUGE_PAGES ? HUGE_PAGE_SIZE : arena->page_size);
+
+  if (keep >= arena->committed) {
+    return;
+  }
+
+  void* start = ptr_byte_add(arena->base, keep);
+  size_t length = arena->committed - keep;
+
+  madvise(start, length, MADV_DONTNEED);
+  mprotect(start, length, PROT_NONE);
+
+  arena->committed = keep;
+  arena->commit_chunk = min_commit_chunk();
+}
+
+size_t arena_committed(Arena* arena) {
+  return arena->committed;
+}
+
+void arena_set_decommit_policy(ArenaDecommitPolicy policy) {
+  decommit_policy = policy;
+}
+
+void init_scratch_arenas() {
+  for (size_t i = 0; i < ARRAY_LENGTH(scratch_arenas); ++i) {
+    scratch_arenas[i] = new_arena();
+  }
+}
+
+void free_scratch_arenas() {
+  for (size_t i = 0; i < ARRAY_LENGTH(scratch_arenas); ++i) {
+    free_arena(scratch_arenas[i]);
+  }
+}
+
+Scratch scratch_get(int num_conflicts, Arena** conflicts) {
+  for (size_t i = 0; i < ARRAY_LENGTH(scratch_arenas); ++i) {
+    Arena* arena = scratch_arenas[i];
+    assert(arena && "scratch arenas not initialized");
+
+    bool no_conflicts = true;
+
+    for (int j = 0; j < num_conflicts; ++j) {
+      if (arena == conflicts[j]) {
+        no_conflicts = false;
+        break;
+      }
+    }
+
+    if (no_conflicts) {
+      size_t save = arena->allocated;
+
+      ScratchImpl* impl = arena_type(arena, ScratchImpl);
+      impl->save = save;
+
+      return (Scratch) {
+        .arena = arena,
+        .impl = impl
+      };
+    }
+  }
+
+  assert(false && "unable to find non-conflicting scratch arena");
+  return (Scratch) {0};
+}
+
+void scratch_release(Scratch* scratch) {
+  size_t save = scratch->impl->save;
+  Arena* arena = scratch->arena;
+
+  assert(save <= arena->allocated);
+
+#if _DEBUG
+  memset(ptr_byte_add(arena->base, save), 0, arena->allocated - save);
+  memset(scratch, 0, sizeof(*scratch));
+#endif
+
+  arena->allocated = save;
+
+  if (arena->committed > decommit_policy.high_water) {
+    arena_trim(arena, decommit_policy.retain);
+  }
+}
\ No newline at end of file
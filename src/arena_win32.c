@@ -6,16 +6,20 @@
 
 #define ARENA_CAPACITY ((size_t)8 * 1024 * 1024 * 1024)
 
+// Commits start small and double every time the arena grows, so a large
+// token or node array costs a handful of VirtualAlloc calls instead of one per page.
+#define ARENA_MIN_COMMIT ((size_t)64 * 1024)
+#define ARENA_MAX_COMMIT ((size_t)64 * 1024 * 1024)
+
 struct Arena {
   void* base;
   
   size_t allocated;
-  size_t capacity;
+  size_t committed;
+  size_t reserved;
 
-  void* next_page;
+  size_t commit_chunk;
   size_t page_size;
-
-  void* page_end;
 };
 
 struct ScratchImpl {
@@ -24,6 +28,11 @@ struct ScratchImpl {
 
 static thread_local Arena* scratch_arenas[2];
 
+static ArenaDecommitPolicy decommit_policy = {
+  .high_water = (size_t)256 * 1024 * 1024,
+  .retain = (size_t)16 * 1024 * 1024
+};
+
 Arena* new_arena() {
   Arena* arena = LocalAlloc(LMEM_ZEROINIT, sizeof(Arena));
 
@@ -31,6 +40,7 @@ Arena* new_arena() {
   GetSystemInfo(&sys);
 
   arena->page_size = sys.dwPageSize;
+  arena->commit_chunk = ARENA_MIN_COMMIT;
 
   size_t page_count = (ARENA_CAPACITY + arena->page_size - 1) / arena->page_size;
   size_t reserve_size = page_count * arena->page_size;
@@ -42,8 +52,7 @@ Arena* new_arena() {
     exit(1);
   }
 
-  arena->next_page = arena->base;
-  arena->page_end = ptr_byte_add(arena->base, reserve_size);
+  arena->reserved = reserve_size;
 
   return arena;
 }
@@ -53,6 +62,36 @@ void free_arena(Arena* arena) {
   LocalFree(arena);
 }
 
+static void arena_commit(Arena* arena, size_t required) {
+  if (required > arena->reserved) {
+    fprintf(stderr, "Arena address space exhausted.\n");
+    exit(1);
+  }
+
+  size_t target = (required + arena->page_size - 1) / arena->page_size * arena->page_size;
+
+  if (target - arena->committed < arena->commit_chunk) {
+    target = arena->committed + arena->commit_chunk;
+  }
+
+  if (target > arena->reserved) {
+    target = arena->reserved;
+  }
+
+  void* start = ptr_byte_add(arena->base, arena->committed);
+
+  if (VirtualAlloc(start, target - arena->committed, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+    fprintf(stderr, "Failed to commit arena memory.\n");
+    exit(1);
+  }
+
+  arena->committed = target;
+
+  if (arena->commit_chunk < ARENA_MAX_COMMIT) {
+    arena->commit_chunk *= 2;
+  }
+}
+
 void* arena_push(Arena* arena, size_t amount) {
   if (amount == 0) {
     return NULL;
@@ -60,16 +99,8 @@ void* arena_push(Arena* arena, size_t amount) {
 
   size_t offset = (arena->allocated + 7) & (~7);
 
-  while (arena->capacity - offset < amount) {
-    if (arena->next_page == arena->page_end) {
-      fprintf(stderr, "Arena address space exhausted.\n");
-      exit(1);
-    }
-
-    VirtualAlloc(arena->next_page, arena->page_size, MEM_COMMIT, PAGE_READWRITE);
-
-    arena->next_page = ptr_byte_add(arena->next_page, arena->page_size);
-    arena->capacity += arena->page_size;
+  if (arena->committed - offset < amount) {
+    arena_commit(arena, offset + amount);
   }
 
   void* ptr = ptr_byte_add(arena->base, offset);
@@ -84,6 +115,47 @@ void* arena_zeroed(Arena* arena, size_t amount) {
   return ptr;
 }
 
+bool arena_resize(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+  if (ptr_byte_add(ptr, old_size) != ptr_byte_add(arena->base, arena->allocated)) {
+    return false;
+  }
+
+  size_t offset = arena->allocated - old_size;
+
+  if (arena->committed - offset < new_size) {
+    arena_commit(arena, offset + new_size);
+  }
+
+  arena->allocated = offset + new_size;
+
+  return true;
+}
+
+void arena_trim(Arena* arena, size_t keep_bytes) {
+  if (keep_bytes < arena->allocated) {
+    keep_bytes = arena->allocated;
+  }
+
+  size_t keep = (keep_bytes + arena->page_size - 1) / arena->page_size * arena->page_size;
+
+  if (keep >= arena->committed) {
+    return;
+  }
+
+  VirtualFree(ptr_byte_add(arena->base, keep), arena->committed - keep, MEM_DECOMMIT);
+
+  arena->committed = keep;
+  arena->commit_chunk = ARENA_MIN_COMMIT;
+}
+
+size_t arena_committed(Arena* arena) {
+  return arena->committed;
+}
+
+void arena_set_decommit_policy(ArenaDecommitPolicy policy) {
+  decommit_policy = policy;
+}
+
 void init_scratch_arenas() {
   for (int i = 0; i < ARRAY_LENGTH(scratch_arenas); ++i) {
     scratch_arenas[i] = new_arena();
@@ -139,4 +211,8 @@ void scratch_release(Scratch* scratch) {
 #endif
 
   arena->allocated = save;
+
+  if (arena->committed > decommit_policy.high_water) {
+    arena_trim(arena, decommit_policy.retain);
+  }
 }
\ No newline at end of file
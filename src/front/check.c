@@ -1,22 +1,26 @@
 #include "front.h"
 
-typedef struct SymbolTableEntry SymbolTableEntry;
-
-struct SymbolTableEntry {
-  SymbolTableEntry* next;
-  Str name;
+typedef struct {
+  Symbol symbol; // SYMBOL_NONE for an empty slot
   SemPlace place;
-};
+} SymbolSlot;
 
 typedef struct {
-  SymbolTableEntry* head;
-} SymbolTable; // TODO: convert to a hash-map
+  Symbol symbol;
+  SemPlace shadowed; // SEM_NULL_PLACE if nothing was visible before
+} SymbolUndo;
 
-typedef struct Scope Scope;
-struct Scope {
-  Scope* parent;
-  SymbolTable locals;
-};
+// Every symbol visible from the current block, in one open-addressing
+// table. Declarations are logged so leaving a block only undoes its own.
+typedef struct {
+  Arena* arena;
+
+  SymbolSlot* slots;
+  uint32_t mask;
+  int count;
+
+  Vec(SymbolUndo) undo;
+} SymbolTable;
 
 typedef struct {
   int stage;
@@ -25,6 +29,7 @@ typedef struct {
   union {
     struct {
       int initial_stack_state;
+      int scope_mark;
     } block;
     struct {
       SemBlock* entry_head;
@@ -51,36 +56,131 @@ typedef struct {
   Vec(SemPlace) place_stack;
   Vec(SemPlaceData) place_data;
 
-  Scope* current_scope;
+  SymbolTable symbols;
   SemBlock* current_block;
 } Checker;
 
-static SemPlace find_symbol(Scope* scope, Token identifier) {
-  foreach_list(SymbolTableEntry, e, scope->locals.head) {
-    if (e->name.len == identifier.length && memcmp(e->name.s, identifier.start, e->name.len) == 0) {
-      return e->place;
+#define SYMBOL_TABLE_INITIAL_SLOTS 64
+
+static uint32_t hash_symbol(Symbol symbol) {
+  uint32_t hash = symbol * 0x9e3779b1u;
+  return hash ^ (hash >> 16);
+}
+
+static SymbolSlot* new_symbol_slots(Arena* arena, uint32_t count) {
+  SymbolSlot* slots = arena_push(arena, count * sizeof(SymbolSlot));
+
+  for (uint32_t i = 0; i < count; ++i) {
+    slots[i].symbol = SYMBOL_NONE;
+  }
+
+  return slots;
+}
+
+static void init_symbol_table(SymbolTable* table, Arena* arena) {
+  table->arena = arena;
+  table->slots = new_symbol_slots(arena, SYMBOL_TABLE_INITIAL_SLOTS);
+  table->mask = SYMBOL_TABLE_INITIAL_SLOTS - 1;
+  table->count = 0;
+
+  vec_in_arena(table->undo, arena);
+}
+
+// Returns the slot holding 'symbol', or the empty slot it would go in.
+static uint32_t probe_symbol(SymbolTable* table, Symbol symbol) {
+  uint32_t i = hash_symbol(symbol) & table->mask;
+
+  while (table->slots[i].symbol != SYMBOL_NONE && table->slots[i].symbol != symbol) {
+    i = (i + 1) & table->mask;
+  }
+
+  return i;
+}
+
+static void grow_symbol_table(SymbolTable* table) {
+  SymbolSlot* old_slots = table->slots;
+  uint32_t old_count = table->mask + 1;
+
+  // The old slots stay behind in the scratch arena until the checker is done.
+  table->slots = new_symbol_slots(table->arena, old_count * 2);
+  table->mask = old_count * 2 - 1;
+
+  for (uint32_t i = 0; i < old_count; ++i) {
+    if (old_slots[i].symbol != SYMBOL_NONE) {
+      table->slots[probe_symbol(table, old_slots[i].symbol)] = old_slots[i];
+    }
+  }
+}
+
+// Backward-shift deletion: pull later entries of the probe run into the
+// hole so lookups never need tombstones.
+static void remove_symbol_slot(SymbolTable* table, uint32_t hole) {
+  uint32_t i = hole;
+
+  while (true) {
+    i = (i + 1) & table->mask;
+
+    if (table->slots[i].symbol == SYMBOL_NONE) {
+      break;
     }
+
+    uint32_t home = hash_symbol(table->slots[i].symbol) & table->mask;
+
+    if (((i - home) & table->mask) >= ((i - hole) & table->mask)) {
+      table->slots[hole] = table->slots[i];
+      hole = i;
+    }
+  }
+
+  table->slots[hole].symbol = SYMBOL_NONE;
+  table->count--;
+}
+
+static SemPlace find_symbol(SymbolTable* table, Symbol symbol) {
+  SymbolSlot* slot = &table->slots[probe_symbol(table, symbol)];
+  return slot->symbol == symbol ? slot->place : SEM_NULL_PLACE;
+}
+
+static void declare_symbol(SymbolTable* table, Symbol symbol, SemPlace place) {
+  if ((uint32_t)(table->count + 1) * 2 > table->mask + 1) {
+    grow_symbol_table(table);
   }
 
-  if (scope->parent) {
-    return find_symbol(scope->parent, identifier);
+  SymbolSlot* slot = &table->slots[probe_symbol(table, symbol)];
+
+  vec_put(table->undo, ((SymbolUndo) {
+    .symbol = symbol,
+    .shadowed = slot->symbol == symbol ? slot->place : SEM_NULL_PLACE
+  }));
+
+  if (slot->symbol != symbol) {
+    table->count++;
   }
 
-  return SEM_NULL_PLACE;
+  slot->symbol = symbol;
+  slot->place = place;
 }
 
-static void add_local(Checker* c, Token identifier, SemPlace place) {
-  SymbolTableEntry* e = arena_type(c->scratch.arena, SymbolTableEntry);
+static int enter_scope(SymbolTable* table) {
+  return vec_len(table->undo);
+}
 
-  e->name = (Str) {
-    .len = identifier.length,
-    .s = identifier.start
-  };
+static void leave_scope(SymbolTable* table, int mark) {
+  while (vec_len(table->undo) > mark) {
+    SymbolUndo undo = vec_pop(table->undo);
+    uint32_t i = probe_symbol(table, undo.symbol);
 
-  e->place = place;
+    if (undo.shadowed == SEM_NULL_PLACE) {
+      remove_symbol_slot(table, i);
+    }
+    else {
+      table->slots[i].place = undo.shadowed;
+    }
+  }
+}
 
-  e->next = c->current_scope->locals.head;
-  c->current_scope->locals.head = e;
+static void add_local(Checker* c, Symbol symbol, SemPlace place) {
+  declare_symbol(&c->symbols, symbol, place);
 }
 
 static CheckItem item(ParseNode* node) {
@@ -116,7 +216,7 @@ static void next_stage(Checker* c, CheckItem x) {
 }
 
 static bool unhandled_check(Checker* c, CheckItem x) {
-  error_token(c->path, c->source, x.node->token, "compiler bug: checker hit unexpected node '%s': '%.*s'", parse_node_label[x.node->kind], x.node->token.length, x.node->token.start);
+  error_token(c->path, c->source, x.node->token, "compiler bug: checker hit unexpected node '%s': '%.*s'", parse_node_label[x.node->kind], x.node->token.length, token_start(c->source, x.node->token));
   return false;
 }
 
@@ -128,9 +228,9 @@ static void push_place(Checker* c, SemPlace place) {
   vec_put(c->place_stack, place);
 }
 
-static SemPlace new_place(Checker* c) {
+static SemPlace new_place(Checker* c, uint32_t flags) {
   SemPlace place = vec_len(c->place_data);
-  vec_put(c->place_data, (SemPlaceData){0});
+  vec_put(c->place_data, ((SemPlaceData) { .flags = flags }));
   return place;
 }
 
@@ -167,7 +267,7 @@ static void make_inst(Checker* c, bool writes, SemOp op, Token token, int num_re
   SemPlace write = SEM_NULL_PLACE;
 
   if (writes) {
-    write = new_place(c);
+    write = new_place(c, SEM_PLACE_TEMP);
   }
 
   make_inst_base(c, c->current_block, write, op, token, num_reads, data);
@@ -189,9 +289,11 @@ static void get_children(ParseNode* node, ParseNode** children, int capacity) {
 static bool check_INTEGER(Checker* c, CheckItem x) {
   uint64_t value = 0;
 
+  const char* digits = token_start(c->source, x.node->token);
+
   for (int i = 0; i < x.node->token.length; ++i) {
     value *= 10;
-    value += x.node->token.start[i] - '0';
+    value += digits[i] - '0';
   }
 
   make_inst(c, true, SEM_OP_INTEGER_CONST, x.node->token, 0, (void*)value);
@@ -268,13 +370,14 @@ static bool check_ASSIGN(Checker* c, CheckItem x) {
 
       return true;
 
-    case 1:
+    case 1: {
       SemPlace value = pop_place(c);
       SemPlace dest = pop_place(c);
       push_place(c, value);
       make_inst_base(c, c->current_block, dest, SEM_OP_COPY, x.node->token, 1, NULL);
       push_place(c, value);
       return true;
+    }
   }
 }
 
@@ -285,10 +388,7 @@ static bool check_BLOCK(Checker* c, CheckItem x) {
       return false;
 
     case 0: {
-      Scope* scope = arena_type(c->scratch.arena, Scope);
-      scope->parent = c->current_scope;
-      c->current_scope = scope;
-
+      x.as.block.scope_mark = enter_scope(&c->symbols);
       x.as.block.initial_stack_state = vec_len(c->place_stack);
       next_stage(c, x);
 
@@ -301,10 +401,10 @@ static bool check_BLOCK(Checker* c, CheckItem x) {
 
     case 1: {
       while (vec_len(c->place_stack) > x.as.block.initial_stack_state) {
-        vec_pop(c->place_stack);
+        (void)vec_pop(c->place_stack);
       }
 
-      c->current_scope = c->current_scope->parent;
+      leave_scope(&c->symbols, x.as.block.scope_mark);
 
       return true;
     }
@@ -324,14 +424,14 @@ static bool check_LOCAL(Checker* c, CheckItem x) {
     ParseNode* children[2];
     get_children(x.node, children, ARRAY_LENGTH(children));
 
-    Token name = children[0]->token;
+    ParseNode* name = children[0];
 
-    if (find_symbol(c->current_scope, name) != SEM_NULL_PLACE) {
-      error_token(c->path, c->source, name, "this name clashes with an existing symbol");
+    if (find_symbol(&c->symbols, name->symbol) != SEM_NULL_PLACE) {
+      error_token(c->path, c->source, name->token, "this name clashes with an existing symbol");
       return false;
     }
 
-    add_local(c, name, new_place(c));
+    add_local(c, name->symbol, new_place(c, 0));
 
     return true;
   }
@@ -342,7 +442,7 @@ static bool check_LOCAL(Checker* c, CheckItem x) {
 }
 
 static bool check_SYMBOL(Checker* c, CheckItem x) {
-  SemPlace place = find_symbol(c->current_scope, x.node->token);
+  SemPlace place = find_symbol(&c->symbols, x.node->symbol);
 
   if (place == SEM_NULL_PLACE) {
     error_token(c->path, c->source, x.node->token, "symbol does not exist in this scope");
@@ -498,6 +598,8 @@ SemFunc* check_tree(Arena* arena, const char* path, const char* source, ParseTre
     .source = source,
   };
 
+  init_symbol_table(&c.symbols, c.scratch.arena);
+
   SemBlock* root = new_block(&c, NULL);
 
   push(&c, item(&tree->nodes[tree->num_nodes-1]));
@@ -525,6 +627,8 @@ SemFunc* check_tree(Arena* arena, const char* path, const char* source, ParseTre
   func->cfg = root;
   func->place_data = c.place_data;
 
+  sem_mark_value_places(func);
+
   end:
   scratch_release(&c.scratch);
   vec_free(c.tree_stack);
@@ -1,17 +1,66 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <threads.h>
 
 #include "front.h"
 
-void error_token(const char* path, const char* source, Token token, const char* fmt, ...) {
-  const char* line_start = token.start;
+// Offsets of every line start in the last source an error was reported
+// against. Errors are rare, so the table is only built once one happens.
+// The key is only the buffer address, so the lexer drops the table for any
+// text it is handed, which may be an edit made in place.
+static thread_local const char* line_table_source;
+static thread_local Vec(uint32_t) line_table;
+
+void forget_line_table(const char* source) {
+  if (line_table_source == source) {
+    line_table_source = NULL;
+  }
+}
+
+static void build_line_table(const char* source) {
+  vec_free(line_table);
+  line_table = NULL;
+
+  vec_put(line_table, 0);
+
+  Scanner scan = get_scanner();
+
+  for (const char* p = scan.line(source); *p; p = scan.line(p + 1)) {
+    vec_put(line_table, (uint32_t)(p + 1 - source));
+  }
 
-  while (line_start != source && *line_start != '\n') {
-    line_start--;
+  line_table_source = source;
+}
+
+// Returns the zero-based line containing 'offset'.
+static int find_line(const char* source, uint32_t offset) {
+  if (line_table_source != source) {
+    build_line_table(source);
+  }
+
+  int lo = 0;
+  int hi = vec_len(line_table);
+
+  while (hi - lo > 1) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (line_table[mid] <= offset) {
+      lo = mid;
+    }
+    else {
+      hi = mid;
+    }
   }
 
-  while (isspace(*line_start)) {
+  return lo;
+}
+
+void error_token(const char* path, const char* source, Token token, const char* fmt, ...) {
+  int line = find_line(source, token.offset);
+  const char* line_start = source + line_table[line];
+
+  while (isspace(*line_start) && *line_start != '\n') {
     line_start++;
   }
 
@@ -20,10 +69,10 @@ void error_token(const char* path, const char* source, Token token, const char*
     line_length++;
   }
 
-  int offset = fprintf(stderr, "%s(%d): error: ", path, token.line);
+  int offset = fprintf(stderr, "%s(%d): error: ", path, line + 1);
   fprintf(stderr, "%.*s\n", line_length, line_start);
 
-  offset += (int)(token.start-line_start);
+  offset += (int)(token_start(source, token) - line_start);
 
   fprintf(stderr, "%*s^ ", offset, "");
 
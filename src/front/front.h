@@ -17,16 +17,36 @@ enum {
   TOKEN_KEYWORD_RETURN,
 };
 
+// Tokens refer back into the source by offset. Line numbers are recovered
+// from the source when an error is reported.
 typedef struct {
-  int kind;
-  int length;
-  char* start;
-  int line;
+  uint32_t offset;
+  uint16_t length;
+  uint16_t kind;
 } Token;
 
+static inline const char* token_start(const char* source, Token token) {
+  return source + token.offset;
+}
+
+// Dense ids for identifier text, shared by every source lexed with the
+// same interner. Later stages compare identifiers by id.
+typedef uint32_t Symbol;
+#define SYMBOL_NONE 0xffffffff
+
+typedef struct Interner Interner;
+
+Interner* new_interner();
+void free_interner(Interner* interner);
+
+Symbol intern(Interner* interner, const char* text, int length);
+Str symbol_text(Interner* interner, Symbol symbol);
+int num_symbols(Interner* interner);
+
 typedef struct {
   int count;
   Token* data;
+  Symbol* symbols; // parallel to data, SYMBOL_NONE unless an identifier
 } Tokens;
 
 #define X(name, ...) PARSE_NODE_##name,
@@ -37,23 +57,31 @@ typedef enum {
 } ParseNodeKind;
 #undef X
 
-#define X(name, label, ...) label,
-static const char* parse_node_label[NUM_PARSE_NODE_KINDS] = {
-  "!!uninitialized!!",
-  #include "parse_node.def"
-};
-#undef X
+extern const char* parse_node_label[NUM_PARSE_NODE_KINDS];
 
 typedef struct {
   ParseNodeKind kind;
   Token token;
+  Symbol symbol;
   int num_children;
   int subtree_size;
 } ParseNode;
 
+// Token range and root node of a statement inside a block, kept so an
+// incremental parse can copy the statement's subtree instead of parsing it.
+typedef struct {
+  int first_token;
+  int num_tokens;
+  int root;
+} ParseStmtSpan;
+
 typedef struct {
+  const char* source;
   ParseNode* nodes;
   int num_nodes;
+
+  ParseStmtSpan* stmts; // in source order, nested statements after their parent
+  int num_stmts;
 } ParseTree;
 
 typedef struct {
@@ -69,18 +97,18 @@ typedef enum {
 } SemOp;
 #undef X
 
-#define X(name, label, ...) label,
-static const char* sem_op_label[] = {
-  "!!uninitialized!!",
-  #include "sem_op.def"
-};
-#undef X
+extern const char* sem_op_label[NUM_SEM_OPS];
 
 typedef uint32_t SemPlace;
 #define SEM_NULL_PLACE 0xffffffff
 
+enum {
+  SEM_PLACE_TEMP = 1, // an expression result rather than a declared local
+  SEM_PLACE_VALUE = 2, // a temp defined once and used at most once, later in the same block
+};
+
 typedef struct {
-  int dummy;
+  uint32_t flags;
 } SemPlaceData;
 
 typedef struct {
@@ -109,10 +137,60 @@ typedef struct {
   Vec(SemPlaceData) place_data;
 } SemFunc;
 
-Tokens lex_source(Arena* arena, char* source);
+enum {
+  CHAR_CLASS_SPACE = 1,
+  CHAR_CLASS_DIGIT = 2,
+  CHAR_CLASS_ALPHA = 4, // letters and '_'
+};
+
+extern const uint8_t char_class[256];
+
+// Byte-class scanners, vectorized where the CPU allows. Each returns the
+// first byte past the run it was asked to skip.
+typedef struct {
+  const char* (*whitespace)(const char* p);
+  const char* (*ident)(const char* p);
+  const char* (*digits)(const char* p);
+  const char* (*line)(const char* p); // stops at '\n' or '\0'
+} Scanner;
+
+Scanner get_scanner();
+
+// 'source' holds 'length' bytes of text followed by a zero byte.
+Tokens lex_source(Arena* arena, Interner* interner, const char* path, const char* source, size_t length);
+
+// lex_source split into exactly 'num_chunks' chunks, whatever the length and
+// processor count. The tokens and symbols come out the same for any count.
+Tokens lex_source_chunks(Arena* arena, Interner* interner, const char* path, const char* source, size_t length, int num_chunks);
+
+// A replacement of 'removed' bytes at 'offset' in the old source by
+// 'inserted' bytes of new text.
+typedef struct {
+  uint32_t offset;
+  uint32_t removed;
+  uint32_t inserted;
+} TextEdit;
+
+// Where two token streams differ after an edit. Tokens before 'first' are
+// identical, tokens after the damage are the same apart from their offset.
+typedef struct {
+  int first;
+  int old_count;
+  int new_count;
+  int64_t byte_delta;
+} TokenDamage;
+
+// Re-lexes the lines touched by 'edit' in 'source', the text after the
+// edit, and reuses the rest of 'old'. 'interner' must be the one 'old' was
+// lexed with.
+Tokens relex_source(Arena* arena, Interner* interner, const char* path, const char* source, Tokens old, TextEdit edit, TokenDamage* damage);
 
 ParseTree* parse(Arena* arena, Tokens tokens, const char* path, const char* source);
 
+// Parses 'tokens' from relex_source, copying statements of 'old' that the
+// damage and the token after them did not touch.
+ParseTree* reparse(Arena* arena, ParseTree* old, Tokens tokens, TokenDamage damage, const char* path, const char* source);
+
 void print_parse_tree(FILE* stream, ParseTree* tree);
 
 ParseChildIterator parse_children_begin(ParseNode* node);
@@ -123,11 +201,20 @@ void parse_children_next(ParseChildIterator* it);
 
 void error_token(const char* path, const char* source, Token token, const char* fmt, ...);
 
+// Drops the line table this thread's error_token built for 'source', whose
+// text has changed since.
+void forget_line_table(const char* source);
+
 SemFunc* check_tree(Arena* arena, const char* path, const char* source, ParseTree* tree);
 void free_sem_func_storage(SemFunc* func);
 
 void print_sem_func(FILE* stream, SemFunc* func);
 
+// Temps that never leave the block they are defined in can be lowered to
+// plain values instead of memory. check_tree marks them, code that moves
+// instructions between blocks has to mark them again.
+void sem_mark_value_places(SemFunc* func);
+
 bool sem_analyze_func(const char* path, const char* source, SemFunc* func);
 
 typedef struct {
@@ -139,4 +226,9 @@ SemSuccessors sem_compute_successors(SemBlock* block);
 
 int sem_assign_temp_ids(SemFunc* func);
 
-SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func);
\ No newline at end of file
+typedef enum {
+  LOWER_MEMORY, // an alloca per place, loads and stores left to the optimizer
+  LOWER_SSA, // places become SSA values while lowering, no memory traffic
+} LowerMode;
+
+SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func, LowerMode mode);
\ No newline at end of file
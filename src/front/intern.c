@@ -0,0 +1,149 @@
+#include <stdlib.h>
+
+#include "front.h"
+
+#define INITIAL_SLOTS 1024
+
+typedef struct {
+  uint32_t hash;
+  Symbol symbol;
+} InternSlot;
+
+struct Interner {
+  Arena* arena; // symbol text
+  Vec(Str) strings; // indexed by symbol
+
+  // Open addressing with linear probing, kept at most half full.
+  InternSlot* slots;
+  uint32_t slot_mask;
+};
+
+// Identifiers are mostly longer than a word, so hash eight bytes at a time.
+static uint32_t hash_text(const char* text, int length) {
+  uint64_t hash = 0x9e3779b97f4a7c15ull ^ (uint64_t)length;
+
+  int i = 0;
+
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, text + i, sizeof(word));
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+  }
+
+  if (i < length) {
+    uint64_t word = 0;
+    memcpy(&word, text + i, length - i);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+  }
+
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static InternSlot* new_slots(uint32_t count) {
+  InternSlot* slots = malloc(count * sizeof(InternSlot));
+
+  for (uint32_t i = 0; i < count; ++i) {
+    slots[i].symbol = SYMBOL_NONE;
+  }
+
+  return slots;
+}
+
+static void place_slot(InternSlot* slots, uint32_t mask, uint32_t hash, Symbol symbol) {
+  uint32_t i = hash & mask;
+
+  while (slots[i].symbol != SYMBOL_NONE) {
+    i = (i + 1) & mask;
+  }
+
+  slots[i] = (InternSlot) {
+    .hash = hash,
+    .symbol = symbol
+  };
+}
+
+static void grow_slots(Interner* interner) {
+  uint32_t old_count = interner->slot_mask + 1;
+  uint32_t new_mask = old_count * 2 - 1;
+
+  InternSlot* slots = new_slots(new_mask + 1);
+
+  for (uint32_t i = 0; i < old_count; ++i) {
+    InternSlot slot = interner->slots[i];
+
+    if (slot.symbol != SYMBOL_NONE) {
+      place_slot(slots, new_mask, slot.hash, slot.symbol);
+    }
+  }
+
+  free(interner->slots);
+
+  interner->slots = slots;
+  interner->slot_mask = new_mask;
+}
+
+Interner* new_interner() {
+  Interner* interner = calloc(1, sizeof(Interner));
+
+  interner->arena = new_arena();
+  interner->slots = new_slots(INITIAL_SLOTS);
+  interner->slot_mask = INITIAL_SLOTS - 1;
+
+  return interner;
+}
+
+void free_interner(Interner* interner) {
+  free_arena(interner->arena);
+  vec_free(interner->strings);
+  free(interner->slots);
+  free(interner);
+}
+
+Symbol intern(Interner* interner, const char* text, int length) {
+  uint32_t hash = hash_text(text, length);
+
+  for (uint32_t i = hash & interner->slot_mask;; i = (i + 1) & interner->slot_mask) {
+    InternSlot slot = interner->slots[i];
+
+    if (slot.symbol == SYMBOL_NONE) {
+      break;
+    }
+
+    if (slot.hash == hash) {
+      Str s = interner->strings[slot.symbol];
+
+      if (s.len == (size_t)length && memcmp(s.s, text, length) == 0) {
+        return slot.symbol;
+      }
+    }
+  }
+
+  if ((uint32_t)(vec_len(interner->strings) + 1) * 2 > interner->slot_mask + 1) {
+    grow_slots(interner);
+  }
+
+  // Copied so symbols outlive the source they were first seen in.
+  char* copy = arena_push(interner->arena, length + 1);
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+
+  Symbol symbol = (Symbol)vec_len(interner->strings);
+
+  vec_put(interner->strings, ((Str) {
+    .s = copy,
+    .len = length
+  }));
+
+  place_slot(interner->slots, interner->slot_mask, hash, symbol);
+
+  return symbol;
+}
+
+Str symbol_text(Interner* interner, Symbol symbol) {
+  assert(symbol < (Symbol)vec_len(interner->strings));
+  return interner->strings[symbol];
+}
+
+int num_symbols(Interner* interner) {
+  return vec_len(interner->strings);
+}
\ No newline at end of file
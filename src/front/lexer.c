@@ -1,148 +1,428 @@
-#include <ctype.h>
 #include <string.h>
+#include <threads.h>
 
 #include "front.h"
 
-static Token make_token(int kind, int length, char* start, int line) {
+static Token make_token(int kind, const char* start, const char* end, const char* source) {
   return (Token) {
-    .kind = kind,
-    .length = length,
-    .start = start,
-    .line = line
+    .offset = (uint32_t)(start - source),
+    .length = (uint16_t)(end - start),
+    .kind = (uint16_t)kind
   };
 }
 
-static bool is_ident(int c) {
-  return isalnum(c) || c == '_';
-}
+typedef struct {
+  const char* text;
+  int length;
+  int kind;
+} Keyword;
+
+// Perfect hash over the keywords, (length + first char) & 7 gives each one
+// its own slot. Adding a keyword means searching for a new hash.
+#define KEYWORD_HASH(start, length) (((length) + (start)[0]) & 7)
 
-static int check_keyword(const char* start, const char* cursor, const char* keyword, int kind) {
-  size_t len = cursor-start;
+static const Keyword keywords[8] = {
+  [0] = { "return", 6, TOKEN_KEYWORD_RETURN },
+  [1] = { "else", 4, TOKEN_KEYWORD_ELSE },
+  [3] = { "if", 2, TOKEN_KEYWORD_IF },
+  [4] = { "while", 5, TOKEN_KEYWORD_WHILE },
+};
 
-  if (len == strlen(keyword) && memcmp(start, keyword, len * sizeof(char)) == 0) {
-    return kind;
+static int check_keywords(const char* start, const char* cursor) {
+  int length = (int)(cursor - start);
+  const Keyword* k = &keywords[KEYWORD_HASH(start, length)];
+
+  if (k->length == length && memcmp(start, k->text, length) == 0) {
+    return k->kind;
   }
 
   return TOKEN_IDENTIFIER;
 }
 
-static int check_keywords(const char* start, const char* cursor) {
-  switch (start[0]) {
-    default:
-      return TOKEN_IDENTIFIER;
-    case 'i':
-      return check_keyword(start, cursor, "if", TOKEN_KEYWORD_IF);
-    case 'e':
-      return check_keyword(start, cursor, "else", TOKEN_KEYWORD_ELSE);
-    case 'w':
-      return check_keyword(start, cursor, "while", TOKEN_KEYWORD_WHILE);
-    case 'r':
-      return check_keyword(start, cursor, "return", TOKEN_KEYWORD_RETURN);
-  }
-}
+// Inputs below this size per thread are lexed on the calling thread.
+#define LEX_CHUNK_MIN_SIZE ((size_t)4 * 1024 * 1024)
+#define LEX_MAX_THREADS 64
+
+typedef struct {
+  const char* source;
+  const char* begin;
+  const char* end;
+
+  Interner* interner;
+
+  Vec(Token) tokens;
+  Vec(Symbol) symbols;
 
-Tokens lex_source(Arena* arena, char* source) {
-  Vec(Token) vec = NULL;
+  bool failed;
+  Token error;
 
-  int line = 1;
-  char* cursor = source;
+  // Only used by chunks lexed on a worker thread.
+  Arena* token_arena;
+  Arena* symbol_arena;
+  thrd_t thread;
+  bool threaded;
+} LexChunk;
+
+// Lexes the tokens that start in [begin, end). 'end' is a line start or the
+// terminator, and no token spans a newline, so lexing a source in chunks
+// produces the same tokens as lexing it in one go.
+static void lex_chunk(LexChunk* chunk) {
+  Scanner scan = get_scanner();
+
+  const char* source = chunk->source;
+  const char* cursor = chunk->begin;
 
   while (1) {
 
     while (1) {
-      while (isspace(*cursor)) {
-        if (*cursor == '\n') {
-          line++;
+      // A lone separator is the common case, the SIMD scan only pays off on runs.
+      if (char_class[(uint8_t)*cursor] & CHAR_CLASS_SPACE) {
+        if (char_class[(uint8_t)cursor[1]] & CHAR_CLASS_SPACE) {
+          cursor = scan.whitespace(cursor);
+        }
+        else {
+          cursor++;
         }
-
-        *cursor++;
       }
 
       if (cursor[0] == '/' && cursor[1] == '/') {
-        while (*cursor != '\n' && *cursor != '\0') {
-          ++cursor;
-        }
+        cursor = scan.line(cursor);
       }
       else {
         break;
       }
     }
 
-    if (*cursor == '\0') {
+    if (cursor >= chunk->end) {
       break;
     }
 
-    char* start = cursor++;
-    int start_line = line;
+    const char* start = cursor++;
     int kind = *start;
 
-    switch (*start) {
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-        while (isdigit(*cursor)) {
-          ++cursor;
-        }
+    uint8_t class = char_class[(uint8_t)*start];
+
+    if (class & (CHAR_CLASS_DIGIT | CHAR_CLASS_ALPHA)) {
+      if (class & CHAR_CLASS_DIGIT) {
+        cursor = scan.digits(cursor);
         kind = TOKEN_INTEGER;
-        break;
-      case '_':
-      case 'a':
-      case 'b':
-      case 'c':
-      case 'd':
-      case 'e':
-      case 'f':
-      case 'g':
-      case 'h':
-      case 'i':
-      case 'j':
-      case 'k':
-      case 'l':
-      case 'm':
-      case 'n':
-      case 'o':
-      case 'p':
-      case 'q':
-      case 'r':
-      case 's':
-      case 't':
-      case 'u':
-      case 'v':
-      case 'w':
-      case 'x':
-      case 'y':
-      case 'z':
-        while(is_ident(*cursor)) {
-          cursor++;
-        }
+      }
+      else {
+        cursor = scan.ident(cursor);
         kind = check_keywords(start, cursor);
-        break;
+      }
+
+      if (cursor - start > UINT16_MAX) {
+        chunk->failed = true;
+        chunk->error = make_token(kind, start, start + UINT16_MAX, source);
+        return;
+      }
     }
 
-    vec_put(vec, make_token(
-      kind,
-      (int)(cursor - start),
-      start,
-      start_line
-    ));
+    vec_put(chunk->tokens, make_token(kind, start, cursor, source));
+    vec_put(chunk->symbols, kind == TOKEN_IDENTIFIER ? intern(chunk->interner, start, (int)(cursor - start)) : SYMBOL_NONE);
+  }
+}
+
+static int lex_chunk_thread(void* data) {
+  lex_chunk(data);
+  return 0;
+}
+
+static const char* next_line_start(const char* p, const char* end) {
+  const char* newline = memchr(p, '\n', end - p);
+  return newline ? newline + 1 : end;
+}
+
+static int choose_num_chunks(size_t length) {
+  size_t num_chunks = length / LEX_CHUNK_MIN_SIZE;
+  size_t num_threads = (size_t)get_processor_count();
+
+  if (num_chunks > num_threads) {
+    num_chunks = num_threads;
   }
 
-  vec_put(vec, make_token(
-    TOKEN_EOF,
-    0,
-    cursor,
-    line
-  ));
+  if (num_chunks > LEX_MAX_THREADS) {
+    num_chunks = LEX_MAX_THREADS;
+  }
 
-  return (Tokens) {
-    .count = vec_len(vec),
-    .data = vec_bake(arena, vec)
+  return num_chunks ? (int)num_chunks : 1;
+}
+
+// Chunks intern into their own tables, so their symbols are renumbered into
+// the shared interner here. Walking chunks and their local ids in order
+// interns in first-appearance order, giving the same ids as a serial lex.
+static Tokens stitch_chunks(Arena* arena, Interner* interner, LexChunk* chunks, int num_chunks, const char* end, const char* source) {
+  int count = 1;
+
+  for (int i = 0; i < num_chunks; ++i) {
+    count += vec_len(chunks[i].tokens);
+  }
+
+  Tokens tokens = {
+    .count = count,
+    .data = arena_push(arena, count * sizeof(Token)),
+    .symbols = arena_push(arena, count * sizeof(Symbol))
   };
+
+  int at = 0;
+
+  for (int i = 0; i < num_chunks; ++i) {
+    LexChunk* chunk = &chunks[i];
+    int chunk_count = vec_len(chunk->tokens);
+
+    Scratch scratch = scratch_get(1, &arena);
+
+    int num_local = num_symbols(chunk->interner);
+    Symbol* remap = arena_push(scratch.arena, num_local * sizeof(Symbol));
+
+    for (int j = 0; j < num_local; ++j) {
+      Str text = symbol_text(chunk->interner, j);
+      remap[j] = intern(interner, text.s, (int)text.len);
+    }
+
+    memcpy(tokens.data + at, chunk->tokens, chunk_count * sizeof(Token));
+
+    for (int j = 0; j < chunk_count; ++j) {
+      Symbol symbol = chunk->symbols[j];
+      tokens.symbols[at + j] = symbol == SYMBOL_NONE ? SYMBOL_NONE : remap[symbol];
+    }
+
+    scratch_release(&scratch);
+
+    at += chunk_count;
+  }
+
+  tokens.data[at] = make_token(TOKEN_EOF, end, end, source);
+  tokens.symbols[at] = SYMBOL_NONE;
+
+  return tokens;
+}
+
+static Tokens lex_parallel(Arena* arena, Interner* interner, const char* path, const char* source, size_t length, int num_chunks) {
+  const char* end = source + length;
+
+  LexChunk chunks[LEX_MAX_THREADS] = {0};
+
+  const char* begin = source;
+
+  for (int i = 0; i < num_chunks; ++i) {
+    LexChunk* chunk = &chunks[i];
+
+    chunk->source = source;
+    chunk->begin = begin;
+    chunk->end = i == num_chunks - 1 ? end : next_line_start(source + length / num_chunks * (i + 1), end);
+
+    if (chunk->end < chunk->begin) {
+      chunk->end = chunk->begin;
+    }
+
+    chunk->interner = new_interner();
+    chunk->token_arena = new_arena();
+    chunk->symbol_arena = new_arena();
+
+    vec_in_arena(chunk->tokens, chunk->token_arena);
+    vec_in_arena(chunk->symbols, chunk->symbol_arena);
+
+    begin = chunk->end;
+  }
+
+  // The last chunk runs here rather than leaving this thread idle.
+  for (int i = 0; i < num_chunks - 1; ++i) {
+    chunks[i].threaded = thrd_create(&chunks[i].thread, lex_chunk_thread, &chunks[i]) == thrd_success;
+
+    if (!chunks[i].threaded) {
+      lex_chunk(&chunks[i]);
+    }
+  }
+
+  lex_chunk(&chunks[num_chunks - 1]);
+
+  for (int i = 0; i < num_chunks; ++i) {
+    if (chunks[i].threaded) {
+      thrd_join(chunks[i].thread, NULL);
+    }
+  }
+
+  Tokens tokens = {0};
+
+  int failed = -1;
+
+  for (int i = 0; i < num_chunks; ++i) {
+    if (chunks[i].failed) {
+      failed = i;
+      break;
+    }
+  }
+
+  if (failed >= 0) {
+    error_token(path, source, chunks[failed].error, "this token is longer than %d characters", UINT16_MAX);
+  }
+  else {
+    tokens = stitch_chunks(arena, interner, chunks, num_chunks, end, source);
+  }
+
+  for (int i = 0; i < num_chunks; ++i) {
+    free_interner(chunks[i].interner);
+    free_arena(chunks[i].token_arena);
+    free_arena(chunks[i].symbol_arena);
+  }
+
+  return tokens;
+}
+
+Tokens lex_source_chunks(Arena* arena, Interner* interner, const char* path, const char* source, size_t length, int num_chunks) {
+  assert(num_chunks >= 1 && num_chunks <= LEX_MAX_THREADS);
+
+  forget_line_table(source);
+
+  // Offsets are 32 bits, a source this large is never worth lexing.
+  if (length > UINT32_MAX) {
+    fprintf(stderr, "%s: error: source files are limited to 4GiB\n", path);
+    return (Tokens) {0};
+  }
+
+  if (num_chunks > 1) {
+    return lex_parallel(arena, interner, path, source, length, num_chunks);
+  }
+
+  // Grown in scratch so it never has to step around the token vector.
+  Scratch scratch = scratch_get(1, &arena);
+
+  LexChunk chunk = {
+    .source = source,
+    .begin = source,
+    .end = source + length,
+    .interner = interner
+  };
+
+  vec_in_arena(chunk.tokens, arena);
+  vec_in_arena(chunk.symbols, scratch.arena);
+
+  lex_chunk(&chunk);
+
+  Tokens tokens = {0};
+
+  if (chunk.failed) {
+    error_token(path, source, chunk.error, "this token is longer than %d characters", UINT16_MAX);
+  }
+  else {
+    vec_put(chunk.tokens, make_token(TOKEN_EOF, chunk.end, chunk.end, source));
+    vec_put(chunk.symbols, SYMBOL_NONE);
+
+    tokens = (Tokens) {
+      .count = vec_len(chunk.tokens),
+      .data = vec_bake(arena, chunk.tokens),
+      .symbols = vec_bake(arena, chunk.symbols)
+    };
+  }
+
+  scratch_release(&scratch);
+
+  return tokens;
+}
+
+Tokens lex_source(Arena* arena, Interner* interner, const char* path, const char* source, size_t length) {
+  return lex_source_chunks(arena, interner, path, source, length, choose_num_chunks(length));
+}
+
+// Returns the first token starting at or after 'offset'.
+static int find_token(Tokens tokens, uint32_t offset) {
+  int lo = 0;
+  int hi = tokens.count;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (tokens.data[mid].offset < offset) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+Tokens relex_source(Arena* arena, Interner* interner, const char* path, const char* source, Tokens old, TextEdit edit, TokenDamage* damage) {
+  forget_line_table(source);
+
+  int64_t delta = (int64_t)edit.inserted - (int64_t)edit.removed;
+  size_t length = (size_t)((int64_t)old.data[old.count - 1].offset + delta);
+
+  if (length > UINT32_MAX) {
+    fprintf(stderr, "%s: error: source files are limited to 4GiB\n", path);
+    return (Tokens) {0};
+  }
+
+  // Relex whole lines around the edit, since lines are the one place a
+  // token can never straddle. Text outside the edit is the same in both
+  // sources, so both ends can be found by looking at the new one.
+  const char* begin = source + edit.offset;
+
+  while (begin > source && begin[-1] != '\n') {
+    begin--;
+  }
+
+  const char* end = next_line_start(source + edit.offset + edit.inserted, source + length);
+
+  uint32_t old_begin = (uint32_t)(begin - source);
+  uint32_t old_end = (uint32_t)((int64_t)(end - source) - delta);
+
+  int first = find_token(old, old_begin);
+  int last = find_token(old, old_end);
+
+  LexChunk chunk = {
+    .source = source,
+    .begin = begin,
+    .end = end,
+    .interner = interner
+  };
+
+  lex_chunk(&chunk);
+
+  if (chunk.failed) {
+    error_token(path, source, chunk.error, "this token is longer than %d characters", UINT16_MAX);
+    vec_free(chunk.tokens);
+    vec_free(chunk.symbols);
+    return (Tokens) {0};
+  }
+
+  int relexed = vec_len(chunk.tokens);
+  int count = first + relexed + (old.count - last);
+
+  Tokens tokens = {
+    .count = count,
+    .data = arena_push(arena, count * sizeof(Token)),
+    .symbols = arena_push(arena, count * sizeof(Symbol))
+  };
+
+  memcpy(tokens.data, old.data, first * sizeof(Token));
+  memcpy(tokens.symbols, old.symbols, first * sizeof(Symbol));
+
+  if (relexed) {
+    memcpy(tokens.data + first, chunk.tokens, relexed * sizeof(Token));
+    memcpy(tokens.symbols + first, chunk.symbols, relexed * sizeof(Symbol));
+  }
+
+  for (int i = last; i < old.count; ++i) {
+    Token token = old.data[i];
+    token.offset = (uint32_t)((int64_t)token.offset + delta);
+
+    tokens.data[first + relexed + i - last] = token;
+    tokens.symbols[first + relexed + i - last] = old.symbols[i];
+  }
+
+  *damage = (TokenDamage) {
+    .first = first,
+    .old_count = last - first,
+    .new_count = relexed,
+    .byte_delta = delta
+  };
+
+  vec_free(chunk.tokens);
+  vec_free(chunk.symbols);
+
+  return tokens;
 }
\ No newline at end of file
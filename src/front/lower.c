@@ -1,20 +1,58 @@
 #include "front.h"
 
+typedef struct {
+  SemPlace place; // SEM_NULL_PLACE for an empty slot
+  SB_Node* value;
+} PlaceDef;
+
 typedef struct {
   SB_Node* region;
   SB_Node* mem_phi;
 
   Vec(SB_Node*) ctrl_in;
   Vec(SB_Node*) mem_in;
+  Vec(int) pred_ids; // block id of each entry, -1 for the function start
+
+  // SSA mode only.
+  int num_preds;
+  bool sealed; // every predecessor has been lowered
+  Vec(int) incomplete_phis;
+
+  // Value of each place the block has written or looked up, open addressing
+  // keyed by place. NULL until the first one.
+  PlaceDef* defs;
+  uint32_t def_mask;
+  int num_defs;
 } BlockData;
 
+typedef struct {
+  SB_Node* phi;
+  int block;
+  SemPlace place;
+  Vec(SB_Node*) ins;
+} ValuePhi;
+
+// Builds SSA for places as blocks are lowered, after Braun et al., "Simple
+// and Efficient Construction of Static Single Assignment Form". Phis whose
+// operands turn out all the same are left for sb_opt to remove.
+typedef struct {
+  Arena* arena; // holds the def tables
+  SB_Func* func;
+  BlockData* block_data_map;
+
+  Vec(ValuePhi) phis;
+} SsaBuilder;
+
 typedef struct {
   BlockData* block_data_map;
+  int block_id;
 
   SB_Func* func;
   SB_Node* ctrl;
   SB_Node* mem;
-  SB_Node** places;
+  SB_Node** places; // alloca per place, NULL for value places and in SSA mode
+  SB_Node** values; // result of each value place once defined
+  SsaBuilder* ssa; // NULL in memory mode
 
   Vec(SB_Node*)* v_end_ctrl;
   Vec(SB_Node*)* v_end_mem;
@@ -23,7 +61,160 @@ typedef struct {
   bool had_return;
 } LowerCtx;
 
-#define IN(idx) sb_node_load(ctx->func, ctx->ctrl, ctx->mem, ctx->places[inst->reads[idx]])
+static SB_Node* read_variable(SsaBuilder* b, int block, SemPlace place);
+
+#define DEF_TABLE_INITIAL_SLOTS 8
+
+static uint32_t hash_place(SemPlace place) {
+  uint32_t hash = place * 0x9e3779b1u;
+  return hash ^ (hash >> 16);
+}
+
+// Returns the slot holding 'place', or the empty slot it would go in.
+static uint32_t probe_def(BlockData* data, SemPlace place) {
+  uint32_t i = hash_place(place) & data->def_mask;
+
+  while (data->defs[i].place != SEM_NULL_PLACE && data->defs[i].place != place) {
+    i = (i + 1) & data->def_mask;
+  }
+
+  return i;
+}
+
+// The old slots stay behind in the scratch arena until lowering is done.
+static void grow_defs(SsaBuilder* b, BlockData* data) {
+  PlaceDef* old_defs = data->defs;
+  uint32_t old_count = old_defs ? data->def_mask + 1 : 0;
+  uint32_t count = old_defs ? old_count * 2 : DEF_TABLE_INITIAL_SLOTS;
+
+  data->defs = arena_push(b->arena, count * sizeof(PlaceDef));
+  data->def_mask = count - 1;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    data->defs[i].place = SEM_NULL_PLACE;
+  }
+
+  for (uint32_t i = 0; i < old_count; ++i) {
+    if (old_defs[i].place != SEM_NULL_PLACE) {
+      data->defs[probe_def(data, old_defs[i].place)] = old_defs[i];
+    }
+  }
+}
+
+static SB_Node* find_variable(SsaBuilder* b, int block, SemPlace place) {
+  BlockData* data = &b->block_data_map[block];
+
+  if (!data->defs) {
+    return NULL;
+  }
+
+  PlaceDef* def = &data->defs[probe_def(data, place)];
+  return def->place == place ? def->value : NULL;
+}
+
+static void write_variable(SsaBuilder* b, int block, SemPlace place, SB_Node* value) {
+  BlockData* data = &b->block_data_map[block];
+
+  if (!data->defs || (uint32_t)(data->num_defs + 1) * 2 > data->def_mask + 1) {
+    grow_defs(b, data);
+  }
+
+  PlaceDef* def = &data->defs[probe_def(data, place)];
+
+  if (def->place != place) {
+    def->place = place;
+    data->num_defs++;
+  }
+
+  def->value = value;
+}
+
+static int new_value_phi(SsaBuilder* b, int block, SemPlace place) {
+  vec_put(b->phis, ((ValuePhi) {
+    .phi = sb_node_phi(b->func),
+    .block = block,
+    .place = place
+  }));
+
+  return vec_len(b->phis) - 1;
+}
+
+// Reads can recurse back into here and grow 'phis', so the phi is looked up
+// by index every time.
+static void add_phi_operands(SsaBuilder* b, int phi) {
+  BlockData* data = &b->block_data_map[b->phis[phi].block];
+
+  for (int i = 0; i < vec_len(data->pred_ids); ++i) {
+    int pred = data->pred_ids[i];
+    SB_Node* value = pred < 0 ? sb_node_null(b->func) : read_variable(b, pred, b->phis[phi].place);
+    vec_put(b->phis[phi].ins, value);
+  }
+}
+
+static SB_Node* read_variable_recursive(SsaBuilder* b, int block, SemPlace place) {
+  BlockData* data = &b->block_data_map[block];
+  SB_Node* value = NULL;
+
+  if (!data->sealed) {
+    int phi = new_value_phi(b, block, place);
+    vec_put(data->incomplete_phis, phi);
+    value = b->phis[phi].phi;
+  }
+  else if (vec_len(data->pred_ids) == 1) {
+    int pred = data->pred_ids[0];
+    value = pred < 0 ? sb_node_null(b->func) : read_variable(b, pred, place);
+  }
+  else {
+    int phi = new_value_phi(b, block, place);
+    value = b->phis[phi].phi;
+
+    // Defined before the operands are read so a loop finds the phi itself.
+    write_variable(b, block, place, value);
+    add_phi_operands(b, phi);
+  }
+
+  write_variable(b, block, place, value);
+
+  return value;
+}
+
+static SB_Node* read_variable(SsaBuilder* b, int block, SemPlace place) {
+  SB_Node* value = find_variable(b, block, place);
+
+  if (value) {
+    return value;
+  }
+
+  return read_variable_recursive(b, block, place);
+}
+
+static void seal_block(SsaBuilder* b, int block) {
+  BlockData* data = &b->block_data_map[block];
+
+  for (int i = 0; i < vec_len(data->incomplete_phis); ++i) {
+    add_phi_operands(b, data->incomplete_phis[i]);
+  }
+
+  vec_free(data->incomplete_phis);
+  data->incomplete_phis = NULL;
+
+  data->sealed = true;
+}
+
+static SB_Node* read_place(LowerCtx* ctx, SemPlace place) {
+  if (!ctx->places[place]) {
+    if (ctx->values[place]) {
+      return ctx->values[place];
+    }
+
+    assert(ctx->ssa);
+    return read_variable(ctx->ssa, ctx->block_id, place);
+  }
+
+  return sb_node_load(ctx->func, ctx->ctrl, ctx->mem, ctx->places[place]);
+}
+
+#define IN(idx) read_place(ctx, inst->reads[idx])
 
 static SB_Node* lower_INTEGER_CONST(LowerCtx* ctx, SemInst* inst) {
   return sb_node_constant(ctx->func, (uint64_t)inst->data);
@@ -61,16 +252,22 @@ static SB_Node* lower_RETURN(LowerCtx* ctx, SemInst* inst) {
   return NULL;
 }
 
-static void push_block_entry(BlockData* data, SB_Node* ctrl, SB_Node* mem) {
+static void push_block_entry(LowerCtx* ctx, int block, SB_Node* ctrl, SB_Node* mem) {
+  BlockData* data = &ctx->block_data_map[block];
+
   vec_put(data->ctrl_in, ctrl);
   vec_put(data->mem_in, mem);
+  vec_put(data->pred_ids, ctx->block_id);
+
+  if (ctx->ssa && vec_len(data->pred_ids) == data->num_preds) {
+    seal_block(ctx->ssa, block);
+  }
 }
 
 static SB_Node* lower_GOTO(LowerCtx* ctx, SemInst* inst) {
   SemBlock* block = inst->data;
-  BlockData* block_data = &ctx->block_data_map[block->_id];
 
-  push_block_entry(block_data, ctx->ctrl, ctx->mem);
+  push_block_entry(ctx, block->_id, ctx->ctrl, ctx->mem);
 
   return NULL;
 }
@@ -78,21 +275,18 @@ static SB_Node* lower_GOTO(LowerCtx* ctx, SemInst* inst) {
 static SB_Node* lower_BRANCH(LowerCtx* ctx, SemInst* inst) {
   SemBlock** locs = inst->data;
 
-  BlockData* block_true = &ctx->block_data_map[locs[0]->_id];
-  BlockData* block_false = &ctx->block_data_map[locs[1]->_id];
-
   SB_Node* branch = ctx->ctrl = sb_node_branch(ctx->func, ctx->ctrl, IN(0));
 
   SB_Node* branch_true = sb_node_branch_true(ctx->func, branch);
   SB_Node* branch_false = sb_node_branch_false(ctx->func, branch);
 
-  push_block_entry(block_true, branch_true, ctx->mem);
-  push_block_entry(block_false, branch_false, ctx->mem);
+  push_block_entry(ctx, locs[0]->_id, branch_true, ctx->mem);
+  push_block_entry(ctx, locs[1]->_id, branch_false, ctx->mem);
 
   return NULL;
 }
 
-SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func) {
+SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func, LowerMode mode) {
   Scratch scratch = scratch_get(0, NULL);
 
   SB_Func* sb_func = sb_begin_func(sb);
@@ -104,15 +298,47 @@ SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func) {
   int num_blocks = sem_assign_temp_ids(func);
   BlockData* block_data_map = arena_array(scratch.arena, BlockData, num_blocks);
 
-  SB_Node** places = arena_array(scratch.arena, SB_Node*, vec_len(func->place_data));
+  int num_places = vec_len(func->place_data);
+
+  SB_Node** places = arena_array(scratch.arena, SB_Node*, num_places);
+  SB_Node** values = arena_array(scratch.arena, SB_Node*, num_places);
 
   Vec(SB_Node*) v_end_ctrl = NULL;
   Vec(SB_Node*) v_end_mem = NULL;
   Vec(SB_Node*) v_end_val = NULL;
 
-  for (int i = 0; i < vec_len(func->place_data); ++i) {
-    places[i] = sb_node_alloca(sb_func);
+  SsaBuilder ssa = {
+    .arena = scratch.arena,
+    .func = sb_func,
+    .block_data_map = block_data_map
+  };
+
+  if (mode == LOWER_SSA) {
+    block_data_map[0].num_preds = 1;
+
+    foreach_list(SemBlock, block, func->cfg) {
+      SemSuccessors succ = sem_compute_successors(block);
+
+      for (int i = 0; i < succ.count; ++i) {
+        block_data_map[succ.data[i]->_id].num_preds++;
+      }
+    }
   }
+  else {
+    for (int i = 0; i < num_places; ++i) {
+      if (!(func->place_data[i].flags & SEM_PLACE_VALUE)) {
+        places[i] = sb_node_alloca(sb_func);
+      }
+    }
+  }
+
+  LowerCtx start_ctx = {
+    .block_data_map = block_data_map,
+    .block_id = -1,
+    .ssa = mode == LOWER_SSA ? &ssa : NULL
+  };
+
+  push_block_entry(&start_ctx, 0, start_ctrl, start_mem);
 
   for (SemBlock* block = func->cfg; block; block = block->next) {
     BlockData* block_data = &block_data_map[block->_id];
@@ -122,11 +348,14 @@ SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func) {
 
     LowerCtx ctx = {
       .block_data_map = block_data_map,
+      .block_id = block->_id,
 
       .func = sb_func,
       .ctrl = block_data->region,
       .mem = block_data->mem_phi,
       .places = places,
+      .values = values,
+      .ssa = start_ctx.ssa,
 
       .v_end_ctrl = &v_end_ctrl,
       .v_end_mem = &v_end_mem,
@@ -149,7 +378,16 @@ SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func) {
 
       if (inst->write != SEM_NULL_PLACE) {
         assert(result != NULL);
-        ctx.mem = sb_node_store(sb_func, ctx.ctrl, ctx.mem, places[inst->write], result);
+
+        if (places[inst->write]) {
+          ctx.mem = sb_node_store(sb_func, ctx.ctrl, ctx.mem, places[inst->write], result);
+        }
+        else if (func->place_data[inst->write].flags & SEM_PLACE_VALUE) {
+          values[inst->write] = result;
+        }
+        else {
+          write_variable(&ssa, block->_id, inst->write, result);
+        }
       }
     }
 
@@ -158,18 +396,28 @@ SB_Func* lower_sem_func(SB_Context* sb, SemFunc* func) {
     }
   }
 
-  push_block_entry(&block_data_map[0], start_ctrl, start_mem);
-
   for (int i = 0; i < num_blocks; ++i) {
     BlockData* data = &block_data_map[i];
 
+    assert(mode != LOWER_SSA || data->sealed);
+
     sb_set_region_ins(sb_func, data->region, vec_len(data->ctrl_in), data->ctrl_in);
     sb_set_phi_ins(sb_func, data->mem_phi, data->region, vec_len(data->mem_in), data->mem_in);
 
     vec_free(data->ctrl_in);
     vec_free(data->mem_in);
+    vec_free(data->pred_ids);
   }
 
+  for (int i = 0; i < vec_len(ssa.phis); ++i) {
+    ValuePhi* phi = &ssa.phis[i];
+
+    sb_set_phi_ins(sb_func, phi->phi, block_data_map[phi->block].region, vec_len(phi->ins), phi->ins);
+    vec_free(phi->ins);
+  }
+
+  vec_free(ssa.phis);
+
   SB_Node* end_region = sb_node_region(sb_func);
   SB_Node* end_mem = sb_node_phi(sb_func);
   SB_Node* end_val = sb_node_phi(sb_func);
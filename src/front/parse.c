@@ -2,6 +2,13 @@
 
 #include "front.h"
 
+#define X(name, label, ...) label,
+const char* parse_node_label[NUM_PARSE_NODE_KINDS] = {
+  "!!uninitialized!!",
+  #include "parse_node.def"
+};
+#undef X
+
 typedef enum {
   STATE_PRIMARY,
 
@@ -39,6 +46,7 @@ typedef struct {
     struct {
       int count;
       Token lbrace;
+      int span; // statement that ends at this state, -1 for none
     } block_stmt;
     Token else_if_tok;
   } as;
@@ -52,8 +60,13 @@ typedef struct {
   Tokens tokens;
 
   Vec(ParseNode) nodes;
+  Vec(ParseStmtSpan) stmts;
 
   Vec(State) stack;
+
+  // Set for an incremental parse.
+  ParseTree* old;
+  TokenDamage damage;
 } Parser;
 
 ParseChildIterator parse_children_begin(ParseNode* node) {
@@ -78,6 +91,7 @@ static void make_node(Parser* p, ParseNodeKind kind, Token token, int num_childr
   ParseNode n = {
     .kind = kind,
     .token = token,
+    .symbol = SYMBOL_NONE,
     .num_children = num_children,
     .subtree_size = 1,
   };
@@ -93,6 +107,11 @@ static void make_node(Parser* p, ParseNodeKind kind, Token token, int num_childr
   vec_put(p->nodes, n);
 }
 
+static void make_symbol_node(Parser* p, ParseNodeKind kind, Token token, Symbol symbol) {
+  make_node(p, kind, token, 0);
+  p->nodes[vec_len(p->nodes)-1].symbol = symbol;
+}
+
 static void push_state(Parser* p, State state) {
   vec_put(p->stack, state);
 }
@@ -111,6 +130,10 @@ static Token peekn(Parser* p, int offset) {
   return p->tokens.data[index];
 }
 
+static Symbol peek_symbol(Parser* p) {
+  return p->tokens.symbols[p->cur_token];
+}
+
 static Token lex(Parser* p) {
   Token token = peek(p);
 
@@ -147,11 +170,12 @@ static State state_block() {
   };
 }
 
-static State state_block_stmt(Token lbrace, int num_stmts) {
+static State state_block_stmt(Token lbrace, int num_stmts, int span) {
   return (State) {
     .kind = STATE_BLOCK_STMT,
     .as.block_stmt.lbrace = lbrace,
     .as.block_stmt.count = num_stmts,
+    .as.block_stmt.span = span,
   };
 }
 
@@ -253,6 +277,89 @@ static bool match(Parser* p, int kind, const char* message) {
   return false;
 }
 
+static int find_stmt(ParseTree* tree, int first_token) {
+  int lo = 0;
+  int hi = tree->num_stmts;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (tree->stmts[mid].first_token < first_token) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  if (lo < tree->num_stmts && tree->stmts[lo].first_token == first_token) {
+    return lo;
+  }
+
+  return -1;
+}
+
+// Copies the old statement starting at the current token, provided neither
+// its tokens nor the one token of lookahead after it were damaged. Nodes
+// after the edit get their offsets moved, nothing else about them changes.
+static bool reuse_stmt(Parser* p) {
+  if (!p->old) {
+    return false;
+  }
+
+  TokenDamage d = p->damage;
+
+  int cur = p->cur_token;
+  int old_cur;
+  int64_t byte_shift;
+
+  if (cur < d.first) {
+    old_cur = cur;
+    byte_shift = 0;
+  }
+  else if (cur >= d.first + d.new_count) {
+    old_cur = cur - (d.new_count - d.old_count);
+    byte_shift = d.byte_delta;
+  }
+  else {
+    return false;
+  }
+
+  int index = find_stmt(p->old, old_cur);
+
+  if (index < 0) {
+    return false;
+  }
+
+  ParseStmtSpan span = p->old->stmts[index];
+  int old_end = span.first_token + span.num_tokens;
+
+  if (old_cur < d.first && old_end >= d.first) {
+    return false;
+  }
+
+  ParseNode* root = &p->old->nodes[span.root];
+  int first_node = span.root - root->subtree_size + 1;
+  int node_shift = vec_len(p->nodes) - first_node;
+
+  for (int i = first_node; i <= span.root; ++i) {
+    ParseNode node = p->old->nodes[i];
+    node.token.offset = (uint32_t)((int64_t)node.token.offset + byte_shift);
+    vec_put(p->nodes, node);
+  }
+
+  for (int i = index; i < p->old->num_stmts && p->old->stmts[i].first_token < old_end; ++i) {
+    ParseStmtSpan nested = p->old->stmts[i];
+    nested.first_token += cur - old_cur;
+    nested.root += node_shift;
+    vec_put(p->stmts, nested);
+  }
+
+  p->cur_token += span.num_tokens;
+
+  return true;
+}
+
 #define REQUIRE(p, kind, msg) \
   do { \
     if (!match(p, kind, msg)) {\
@@ -273,8 +380,9 @@ static bool handle_state(Parser* p, State state) {
           return false;
 
         case TOKEN_IDENTIFIER: {
+          Symbol symbol = peek_symbol(p);
           Token tok = lex(p);
-          make_node(p, PARSE_NODE_SYMBOL, tok, 0);
+          make_symbol_node(p, PARSE_NODE_SYMBOL, tok, symbol);
           return true;
         }
 
@@ -320,11 +428,17 @@ static bool handle_state(Parser* p, State state) {
     case STATE_BLOCK: {
       Token lbrace = peek(p);
       REQUIRE(p, '{', "expected a block '{'");
-      push_state(p, state_block_stmt(lbrace, 0));
+      push_state(p, state_block_stmt(lbrace, 0, -1));
       return true;
     }
 
     case STATE_BLOCK_STMT: {
+      if (state.as.block_stmt.span >= 0) {
+        ParseStmtSpan* span = &p->stmts[state.as.block_stmt.span];
+        span->num_tokens = p->cur_token - span->first_token;
+        span->root = vec_len(p->nodes) - 1;
+      }
+
       if (peek(p).kind == '}') {
         lex(p);
         make_node(p, PARSE_NODE_BLOCK, state.as.block_stmt.lbrace, state.as.block_stmt.count);
@@ -336,7 +450,18 @@ static bool handle_state(Parser* p, State state) {
         return false;
       }
 
-      push_state(p, state_block_stmt(state.as.block_stmt.lbrace, state.as.block_stmt.count+1));
+      if (reuse_stmt(p)) {
+        push_state(p, state_block_stmt(state.as.block_stmt.lbrace, state.as.block_stmt.count+1, -1));
+        return true;
+      }
+
+      int span = vec_len(p->stmts);
+
+      vec_put(p->stmts, ((ParseStmtSpan) {
+        .first_token = p->cur_token
+      }));
+
+      push_state(p, state_block_stmt(state.as.block_stmt.lbrace, state.as.block_stmt.count+1, span));
 
       switch (peek(p).kind) {
         default:
@@ -378,16 +503,18 @@ static bool handle_state(Parser* p, State state) {
 
     case STATE_LOCAL: {
       Token name = peek(p);
+      Symbol name_symbol = peek_symbol(p);
       REQUIRE(p, TOKEN_IDENTIFIER, "expected a local declaration");
 
       Token colon = peek(p);
       REQUIRE(p, ':', "expected local declaration, consider adding a ':' here");
 
       Token type = peek(p);
+      Symbol type_symbol = peek_symbol(p);
       REQUIRE(p, TOKEN_IDENTIFIER, "expected a typename");
 
-      make_node(p, PARSE_NODE_IDENTIFIER, name, 0);
-      make_node(p, PARSE_NODE_TYPENAME, type, 0);
+      make_symbol_node(p, PARSE_NODE_IDENTIFIER, name, name_symbol);
+      make_symbol_node(p, PARSE_NODE_TYPENAME, type, type_symbol);
 
       if (peek(p).kind == '=') {
         lex(p);
@@ -465,33 +592,55 @@ static bool handle_state(Parser* p, State state) {
   }
 }
 
-ParseTree* parse(Arena* arena, Tokens tokens, const char* path, const char* source) {
-  Parser p = {
-    .path = path,
-    .source = source,
-    .tokens = tokens,
-  };
+static ParseTree* run_parser(Parser* p, Arena* arena) {
+  vec_in_arena(p->nodes, arena);
 
-  push_state(&p, state_block());
+  push_state(p, state_block());
 
   ParseTree* tree = NULL;
 
-  while (vec_len(p.stack)) {
-    State state = vec_pop(p.stack);
-    if (!handle_state(&p, state)) {
+  while (vec_len(p->stack)) {
+    State state = vec_pop(p->stack);
+    if (!handle_state(p, state)) {
+      vec_free(p->stmts);
       goto end;
     }
   }
 
   tree = arena_type(arena, ParseTree);
-  tree->num_nodes = vec_len(p.nodes);
-  tree->nodes = vec_bake(arena, p.nodes);
+  tree->source = p->source;
+  tree->num_nodes = vec_len(p->nodes);
+  tree->nodes = vec_bake(arena, p->nodes);
+  tree->num_stmts = vec_len(p->stmts);
+  tree->stmts = vec_bake(arena, p->stmts);
 
   end:
-  vec_free(p.stack);
+  vec_free(p->stack);
   return tree;
 }
 
+ParseTree* parse(Arena* arena, Tokens tokens, const char* path, const char* source) {
+  Parser p = {
+    .path = path,
+    .source = source,
+    .tokens = tokens,
+  };
+
+  return run_parser(&p, arena);
+}
+
+ParseTree* reparse(Arena* arena, ParseTree* old, Tokens tokens, TokenDamage damage, const char* path, const char* source) {
+  Parser p = {
+    .path = path,
+    .source = source,
+    .tokens = tokens,
+    .old = old,
+    .damage = damage
+  };
+
+  return run_parser(&p, arena);
+}
+
 typedef struct {
   ParseNode* node;
   int depth;
@@ -556,7 +705,7 @@ void print_parse_tree(FILE* stream, ParseTree* tree) {
       }
     }
 
-    fprintf(stream, "%s: '%.*s'\n", parse_node_label[item.node->kind], item.node->token.length, item.node->token.start);
+    fprintf(stream, "%s: '%.*s'\n", parse_node_label[item.node->kind], item.node->token.length, token_start(tree->source, item.node->token));
   }
 
   fprintf(stream, "\n");
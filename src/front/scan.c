@@ -0,0 +1,279 @@
+#include "front.h"
+
+// Every scanner stops at NUL, which is in none of the classes. The SIMD
+// versions never let a load cross into a page the scan has not reached yet.
+// A scan can therefore read past the terminator without faulting, whatever
+// memory follows the source buffer.
+
+#define C_SPACE CHAR_CLASS_SPACE
+#define C_DIGIT CHAR_CLASS_DIGIT
+#define C_ALPHA CHAR_CLASS_ALPHA
+
+const uint8_t char_class[256] = {
+  ['\t'] = C_SPACE, ['\n'] = C_SPACE, ['\v'] = C_SPACE, ['\f'] = C_SPACE, ['\r'] = C_SPACE, [' '] = C_SPACE,
+
+  ['0'] = C_DIGIT, ['1'] = C_DIGIT, ['2'] = C_DIGIT, ['3'] = C_DIGIT, ['4'] = C_DIGIT,
+  ['5'] = C_DIGIT, ['6'] = C_DIGIT, ['7'] = C_DIGIT, ['8'] = C_DIGIT, ['9'] = C_DIGIT,
+
+  ['_'] = C_ALPHA,
+
+  ['a'] = C_ALPHA, ['b'] = C_ALPHA, ['c'] = C_ALPHA, ['d'] = C_ALPHA, ['e'] = C_ALPHA, ['f'] = C_ALPHA,
+  ['g'] = C_ALPHA, ['h'] = C_ALPHA, ['i'] = C_ALPHA, ['j'] = C_ALPHA, ['k'] = C_ALPHA, ['l'] = C_ALPHA,
+  ['m'] = C_ALPHA, ['n'] = C_ALPHA, ['o'] = C_ALPHA, ['p'] = C_ALPHA, ['q'] = C_ALPHA, ['r'] = C_ALPHA,
+  ['s'] = C_ALPHA, ['t'] = C_ALPHA, ['u'] = C_ALPHA, ['v'] = C_ALPHA, ['w'] = C_ALPHA, ['x'] = C_ALPHA,
+  ['y'] = C_ALPHA, ['z'] = C_ALPHA,
+
+  ['A'] = C_ALPHA, ['B'] = C_ALPHA, ['C'] = C_ALPHA, ['D'] = C_ALPHA, ['E'] = C_ALPHA, ['F'] = C_ALPHA,
+  ['G'] = C_ALPHA, ['H'] = C_ALPHA, ['I'] = C_ALPHA, ['J'] = C_ALPHA, ['K'] = C_ALPHA, ['L'] = C_ALPHA,
+  ['M'] = C_ALPHA, ['N'] = C_ALPHA, ['O'] = C_ALPHA, ['P'] = C_ALPHA, ['Q'] = C_ALPHA, ['R'] = C_ALPHA,
+  ['S'] = C_ALPHA, ['T'] = C_ALPHA, ['U'] = C_ALPHA, ['V'] = C_ALPHA, ['W'] = C_ALPHA, ['X'] = C_ALPHA,
+  ['Y'] = C_ALPHA, ['Z'] = C_ALPHA,
+};
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+#define TARGET_AVX2
+#define NO_ASAN __declspec(no_sanitize_address)
+
+static int ctz32(uint32_t x) {
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return (int)index;
+}
+
+static bool cpu_has_avx2() {
+  int info[4];
+  __cpuid(info, 1);
+
+  bool osxsave = (info[2] >> 27) & 1;
+  bool avx = (info[2] >> 28) & 1;
+
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] >> 5) & 1;
+}
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define NO_ASAN __attribute__((no_sanitize_address))
+
+static int ctz32(uint32_t x) {
+  return __builtin_ctz(x);
+}
+
+static bool cpu_has_avx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// The reads past the terminator are safe for the reason above, but ASan
+// only sees them leave the allocation, so the scanners opt out of it.
+
+// Signed-compare trick for lo <= c <= hi, SSE2 has no unsigned byte compare.
+#define RANGE_128(x, lo, hi) _mm_cmplt_epi8(_mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - (lo)))), _mm_set1_epi8((char)((hi) - (lo) + 1 - 0x80)))
+#define RANGE_256(x, lo, hi) _mm256_cmpgt_epi8(_mm256_set1_epi8((char)((hi) - (lo) + 1 - 0x80)), _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - (lo)))))
+
+static uint32_t sse2_space_mask(__m128i x) {
+  __m128i space = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), RANGE_128(x, '\t', '\r'));
+  return (uint32_t)_mm_movemask_epi8(space);
+}
+
+static uint32_t sse2_digit_mask(__m128i x) {
+  return (uint32_t)_mm_movemask_epi8(RANGE_128(x, '0', '9'));
+}
+
+static uint32_t sse2_ident_mask(__m128i x) {
+  __m128i alpha = RANGE_128(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+  __m128i digit = RANGE_128(x, '0', '9');
+  __m128i under = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+  return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+static uint32_t sse2_line_end_mask(__m128i x) {
+  __m128i end = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_setzero_si128()));
+  return (uint32_t)_mm_movemask_epi8(end);
+}
+
+// An unaligned load that stays inside one page is as safe as an aligned one,
+// so the first load of a scan can start right at the cursor. Most tokens and
+// whitespace runs end inside it.
+static bool load_fits_page(const char* p, uintptr_t width) {
+  return ((uintptr_t)p & 4095) <= 4096 - width;
+}
+
+#define SSE2_STOP(x, mask_fn, invert) (((invert) ? ~mask_fn(x) : mask_fn(x)) & 0xffffu)
+
+// Skips bytes whose bit is set in 'mask_fn' (or clear, with 'invert').
+#define SSE2_SKIP(p, mask_fn, invert) \
+  do { \
+    if (load_fits_page(p, 16)) { \
+      uint32_t head = SSE2_STOP(_mm_loadu_si128((const __m128i*)(p)), mask_fn, invert); \
+      if (head) { \
+        (p) += ctz32(head); \
+        break; \
+      } \
+      (p) += 16; \
+    } \
+    uintptr_t misalign = (uintptr_t)(p) & 15; \
+    const char* block = (p) - misalign; \
+    uint32_t stop = SSE2_STOP(_mm_load_si128((const __m128i*)block), mask_fn, invert) & (0xffffu << misalign); \
+    while (!stop) { \
+      block += 16; \
+      stop = SSE2_STOP(_mm_load_si128((const __m128i*)block), mask_fn, invert); \
+    } \
+    (p) = block + ctz32(stop); \
+  } while (false)
+
+NO_ASAN static const char* sse2_ident(const char* p) {
+  SSE2_SKIP(p, sse2_ident_mask, true);
+  return p;
+}
+
+NO_ASAN static const char* sse2_digits(const char* p) {
+  SSE2_SKIP(p, sse2_digit_mask, true);
+  return p;
+}
+
+NO_ASAN static const char* sse2_line(const char* p) {
+  SSE2_SKIP(p, sse2_line_end_mask, false);
+  return p;
+}
+
+NO_ASAN static const char* sse2_whitespace(const char* p) {
+  SSE2_SKIP(p, sse2_space_mask, true);
+  return p;
+}
+
+TARGET_AVX2 static uint32_t avx2_space_mask(__m256i x) {
+  __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), RANGE_256(x, '\t', '\r'));
+  return (uint32_t)_mm256_movemask_epi8(space);
+}
+
+TARGET_AVX2 static uint32_t avx2_digit_mask(__m256i x) {
+  return (uint32_t)_mm256_movemask_epi8(RANGE_256(x, '0', '9'));
+}
+
+TARGET_AVX2 static uint32_t avx2_ident_mask(__m256i x) {
+  __m256i alpha = RANGE_256(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z');
+  __m256i digit = RANGE_256(x, '0', '9');
+  __m256i under = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+  return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+}
+
+TARGET_AVX2 static uint32_t avx2_line_end_mask(__m256i x) {
+  __m256i end = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+  return (uint32_t)_mm256_movemask_epi8(end);
+}
+
+#define AVX2_STOP(x, mask_fn, invert) ((invert) ? ~mask_fn(x) : mask_fn(x))
+
+#define AVX2_SKIP(p, mask_fn, invert) \
+  do { \
+    if (load_fits_page(p, 32)) { \
+      uint32_t head = AVX2_STOP(_mm256_loadu_si256((const __m256i*)(p)), mask_fn, invert); \
+      if (head) { \
+        (p) += ctz32(head); \
+        break; \
+      } \
+      (p) += 32; \
+    } \
+    uintptr_t misalign = (uintptr_t)(p) & 31; \
+    const char* block = (p) - misalign; \
+    uint32_t stop = AVX2_STOP(_mm256_load_si256((const __m256i*)block), mask_fn, invert) & (0xffffffffu << misalign); \
+    while (!stop) { \
+      block += 32; \
+      stop = AVX2_STOP(_mm256_load_si256((const __m256i*)block), mask_fn, invert); \
+    } \
+    (p) = block + ctz32(stop); \
+  } while (false)
+
+NO_ASAN TARGET_AVX2 static const char* avx2_ident(const char* p) {
+  AVX2_SKIP(p, avx2_ident_mask, true);
+  return p;
+}
+
+NO_ASAN TARGET_AVX2 static const char* avx2_digits(const char* p) {
+  AVX2_SKIP(p, avx2_digit_mask, true);
+  return p;
+}
+
+NO_ASAN TARGET_AVX2 static const char* avx2_line(const char* p) {
+  AVX2_SKIP(p, avx2_line_end_mask, false);
+  return p;
+}
+
+NO_ASAN TARGET_AVX2 static const char* avx2_whitespace(const char* p) {
+  AVX2_SKIP(p, avx2_space_mask, true);
+  return p;
+}
+
+Scanner get_scanner() {
+  if (cpu_has_avx2()) {
+    return (Scanner) {
+      .whitespace = avx2_whitespace,
+      .ident = avx2_ident,
+      .digits = avx2_digits,
+      .line = avx2_line
+    };
+  }
+
+  return (Scanner) {
+    .whitespace = sse2_whitespace,
+    .ident = sse2_ident,
+    .digits = sse2_digits,
+    .line = sse2_line
+  };
+}
+
+#else
+
+static const char* scalar_whitespace(const char* p) {
+  while (char_class[(uint8_t)*p] & C_SPACE) {
+    p++;
+  }
+
+  return p;
+}
+
+static const char* scalar_ident(const char* p) {
+  while (char_class[(uint8_t)*p] & (C_ALPHA | C_DIGIT)) {
+    p++;
+  }
+
+  return p;
+}
+
+static const char* scalar_digits(const char* p) {
+  while (char_class[(uint8_t)*p] & C_DIGIT) {
+    p++;
+  }
+
+  return p;
+}
+
+static const char* scalar_line(const char* p) {
+  while (*p != '\n' && *p != '\0') {
+    p++;
+  }
+
+  return p;
+}
+
+Scanner get_scanner() {
+  return (Scanner) {
+    .whitespace = scalar_whitespace,
+    .ident = scalar_ident,
+    .digits = scalar_digits,
+    .line = scalar_line
+  };
+}
+
+#endif
\ No newline at end of file
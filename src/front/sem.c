@@ -2,6 +2,13 @@
 
 #include "front.h"
 
+#define X(name, label, ...) label,
+const char* sem_op_label[NUM_SEM_OPS] = {
+  "!!uninitialized!!",
+  #include "sem_op.def"
+};
+#undef X
+
 void free_sem_func_storage(SemFunc* func) {
   foreach_list(SemBlock, b, func->cfg) {
     vec_free(b->code);
@@ -50,7 +57,7 @@ void print_sem_func(FILE* stream, SemFunc* func) {
 
       switch (inst->op) {
         case SEM_OP_INTEGER_CONST:
-          fprintf(stream, "%lld", (uint64_t)inst->data);
+          fprintf(stream, "%lld", (long long)(uint64_t)inst->data);
           break;
 
         case SEM_OP_GOTO: {
@@ -62,6 +69,9 @@ void print_sem_func(FILE* stream, SemFunc* func) {
           SemBlock** locs = inst->data;
           fprintf(stream, " [bb_%d, bb_%d]", locs[0]->_id, locs[1]->_id);
         } break;
+
+        default:
+          break;
       }
 
       fprintf(stream, "\n");
@@ -87,12 +97,64 @@ SemSuccessors sem_compute_successors(SemBlock* block) {
         result.data[result.count++] = locs[0];
         result.data[result.count++] = locs[1];
       } break;
+
+      default:
+        break;
     }
   }
 
   return result;
 }
 
+void sem_mark_value_places(SemFunc* func) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  int num_places = vec_len(func->place_data);
+
+  SemBlock** def_block = arena_array(scratch.arena, SemBlock*, num_places);
+  uint64_t* defined = arena_array(scratch.arena, uint64_t, bitset_num_u64(num_places));
+  uint64_t* used = arena_array(scratch.arena, uint64_t, bitset_num_u64(num_places));
+  uint64_t* escapes = arena_array(scratch.arena, uint64_t, bitset_num_u64(num_places));
+
+  foreach_list(SemBlock, b, func->cfg) {
+    for (int i = 0; i < vec_len(b->code); ++i) {
+      SemInst* inst = &b->code[i];
+
+      for (int j = 0; j < inst->num_reads; ++j) {
+        SemPlace read = inst->reads[j];
+
+        if (def_block[read] != b || bitset_get(used, read)) {
+          bitset_set(escapes, read);
+        }
+
+        bitset_set(used, read);
+      }
+
+      if (inst->write != SEM_NULL_PLACE) {
+        if (bitset_get(defined, inst->write)) {
+          bitset_set(escapes, inst->write);
+        }
+
+        bitset_set(defined, inst->write);
+        def_block[inst->write] = b;
+      }
+    }
+  }
+
+  for (int i = 0; i < num_places; ++i) {
+    SemPlaceData* data = &func->place_data[i];
+
+    if ((data->flags & SEM_PLACE_TEMP) && !bitset_get(escapes, i)) {
+      data->flags |= SEM_PLACE_VALUE;
+    }
+    else {
+      data->flags &= ~(uint32_t)SEM_PLACE_VALUE;
+    }
+  }
+
+  scratch_release(&scratch);
+}
+
 bool sem_analyze_func(const char* path, const char* source, SemFunc* func) {
   Scratch scratch = scratch_get(0, NULL);
 
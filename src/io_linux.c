@@ -0,0 +1,65 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "utility.h"
+
+bool map_text_file(MappedFile* file, const char* path) {
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  size_t length = (size_t)st.st_size;
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+  // The kernel zero fills the tail of the file's last page. Reserving one
+  // byte more than the file rounds up to an extra zero page when the file
+  // ends exactly on a page boundary, so the terminator is always there.
+  size_t mapping_size = (length + page_size) & ~(page_size - 1);
+
+  char* base = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  if (length && mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(base, mapping_size);
+    close(fd);
+    return false;
+  }
+
+  close(fd);
+
+  madvise(base, length, MADV_SEQUENTIAL);
+
+  *file = (MappedFile) {
+    .data = base,
+    .length = length,
+    .mapping_size = mapping_size
+  };
+
+  return true;
+}
+
+void unmap_text_file(MappedFile* file) {
+  munmap(file->data, file->mapping_size);
+  memset(file, 0, sizeof(*file));
+}
+
+int get_processor_count() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+}
\ No newline at end of file
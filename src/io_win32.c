@@ -0,0 +1,94 @@
+#include <windows.h>
+#include <stdlib.h>
+
+#include "utility.h"
+
+// Views are zero filled past the end of the file up to the next page, which
+// gives the terminator for free unless the file ends on a page boundary.
+// Only then is the file read into a heap buffer instead.
+static bool read_text_file(MappedFile* file, HANDLE handle) {
+  char* buffer = malloc(file->length + 1);
+
+  if (!buffer) {
+    return false;
+  }
+
+  size_t offset = 0;
+
+  while (offset < file->length) {
+    size_t remaining = file->length - offset;
+    DWORD chunk = remaining > MAXDWORD ? MAXDWORD : (DWORD)remaining;
+    DWORD read = 0;
+
+    if (!ReadFile(handle, buffer + offset, chunk, &read, NULL) || read == 0) {
+      free(buffer);
+      return false;
+    }
+
+    offset += read;
+  }
+
+  buffer[file->length] = '\0';
+  file->data = buffer;
+
+  return true;
+}
+
+bool map_text_file(MappedFile* file, const char* path) {
+  HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+
+  if (!GetFileSizeEx(handle, &size)) {
+    CloseHandle(handle);
+    return false;
+  }
+
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  *file = (MappedFile) {
+    .length = (size_t)size.QuadPart
+  };
+
+  if (file->length % info.dwPageSize != 0) {
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mapping) {
+      file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+
+      if (file->data) {
+        file->mapping_size = file->length;
+        CloseHandle(handle);
+        return true;
+      }
+    }
+  }
+
+  bool ok = read_text_file(file, handle);
+  CloseHandle(handle);
+
+  return ok;
+}
+
+void unmap_text_file(MappedFile* file) {
+  if (file->mapping_size) {
+    UnmapViewOfFile(file->data);
+  }
+  else {
+    free(file->data);
+  }
+
+  memset(file, 0, sizeof(*file));
+}
+
+int get_processor_count() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+}
\ No newline at end of file
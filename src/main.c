@@ -1,28 +1,22 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "utility.h"
 #include "front/front.h"
 #include "spindle/spindle.h"
 
-int main() {
-  init_thread();
-
-  Arena* arena = new_arena();
-
-  const char* path = "test/test.txt";
-  char* source = load_text_file(arena, path);
+// Compiles 'source', runs the schedule and prints every stage on the way.
+static bool run_source(Arena* arena, Interner* interner, const char* path, const char* source, size_t length, LowerMode mode) {
+  Tokens tokens = lex_source(arena, interner, path, source, length);
 
-  if (!source) {
-    fprintf(stderr, "Failed to load '%s'\n", path);
-    return 1;
+  if (!tokens.data) {
+    return false;
   }
 
-  Tokens tokens = lex_source(arena, source);
-
   ParseTree* tree = parse(arena, tokens, path, source);
 
   if (!tree) {
-    return 1;
+    return false;
   }
 
   print_parse_tree(stdout, tree);
@@ -30,20 +24,71 @@ int main() {
   SemFunc* func = check_tree(arena, path, source, tree);
 
   if (!func) {
-    return 1;
+    return false;
   }
 
   if(!sem_analyze_func(path, source, func)) {
-    return 1;
+    return false;
   }
 
   print_sem_func(stdout, func);
 
   SB_Context* sb= sb_init();
-  SB_Func* sb_func = lower_sem_func(sb, func);
+  SB_Func* sb_func = lower_sem_func(sb, func, mode);
 
   sb_opt(sb, sb_func);
   sb_graphviz_func(stdout, sb_func);
 
-  return 0;
+  SB_Schedule schedule = sb_schedule_func(arena, sb_func);
+  sb_print_schedule(stdout, sb_func, &schedule);
+
+  uint64_t result;
+
+  if (!sb_run_schedule(sb_func, &schedule, &result)) {
+    return false;
+  }
+
+  printf("returns %lld\n", (long long)result);
+
+  return true;
+}
+
+// cc [--memory] [path]
+//
+// --memory lowers every place to an alloca and leaves promotion to the
+// optimizer instead of building SSA directly.
+int main(int argc, char** argv) {
+  init_thread();
+
+  Arena* arena = new_arena();
+
+  const char* path = "test/test.txt";
+  LowerMode mode = LOWER_SSA;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--memory") == 0) {
+      mode = LOWER_MEMORY;
+    }
+    else {
+      path = argv[i];
+    }
+  }
+
+  MappedFile file;
+
+  if (!map_text_file(&file, path)) {
+    fprintf(stderr, "Failed to load '%s'\n", path);
+    return 1;
+  }
+
+  Interner* interner = new_interner();
+  bool ok = run_source(arena, interner, path, file.data, file.length, mode);
+
+  free_interner(interner);
+  unmap_text_file(&file);
+  free_arena(arena);
+
+  cleanup_thread();
+
+  return ok ? 0 : 1;
 }
\ No newline at end of file
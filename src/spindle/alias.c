@@ -0,0 +1,49 @@
+#include "spindle.h"
+
+#include "utility.h"
+#include "internal.h"
+
+bool sb_alloca_escapes(SB_Func* func, SB_Node* alloca) {
+  assert(alloca->kind == SB_NODE_ALLOCA);
+
+  for (int32_t i = 0; i < alloca->num_uses; ++i) {
+    SB_Use* use = &alloca->uses[i];
+    SB_Node* user = sb_user(func, use);
+
+    if (use->index != 2 || (user->kind != SB_NODE_LOAD && user->kind != SB_NODE_STORE)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// The only addresses so far are allocas, and every other address is treated
+// as an unknown pointer. Distinct allocas never overlap, and an alloca whose
+// address never leaves a load or store cannot be reached through a pointer.
+SB_AliasResult sb_alias(SB_Func* func, SB_Node* a, SB_Node* b) {
+  if (a == b) {
+    return SB_MUST_ALIAS;
+  }
+
+  bool a_alloca = a->kind == SB_NODE_ALLOCA;
+  bool b_alloca = b->kind == SB_NODE_ALLOCA;
+
+  if (a_alloca && b_alloca) {
+    return SB_NO_ALIAS;
+  }
+
+  if (a_alloca && !sb_alloca_escapes(func, a)) {
+    return SB_NO_ALIAS;
+  }
+
+  if (b_alloca && !sb_alloca_escapes(func, b)) {
+    return SB_NO_ALIAS;
+  }
+
+  return SB_MAY_ALIAS;
+}
+
+bool sb_escape_may_read(SB_Func* func, SB_Node* address) {
+  return address->kind != SB_NODE_ALLOCA || sb_alloca_escapes(func, address);
+}
\ No newline at end of file
@@ -1,23 +1,53 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "spindle.h"
 #include "utility.h"
 #include "internal.h"
 
+#define X(name, label, ...) label,
+const char* sb_node_kind_label[NUM_SB_NODE_KINDS] = {
+  "!!uninitialized!!",
+  #include "node_kind.def"
+};
+#undef X
+
 #define DATA(node, ty) ((ty*)(node_data_raw(node)))
 
+// Compact once at least this fraction of allocated ids is dead...
+#define COMPACT_DEAD_FRACTION 0.5
+// ...and the function is big enough for that to matter.
+#define COMPACT_MIN_NODES 1024
+
+#define VALUE_TABLE_INITIAL_SLOTS 256
+
 struct SB_Context {
   Arena* arena;
+  Vec(SB_Func*) funcs;
 };
 
 typedef struct {
   uint64_t value;
 } ConstantData;
 
+struct SB_ValueSlot {
+  uint32_t hash;
+  int32_t node; // 0 for an empty slot
+};
+
 static void* node_data_raw(SB_Node* node) {
   return ptr_byte_add(node, sizeof(SB_Node));
 }
 
+static size_t node_data_size(SB_NodeKind kind) {
+  switch (kind) {
+    default:
+      return 0;
+    case SB_NODE_CONSTANT:
+      return sizeof(ConstantData);
+  }
+}
+
 SB_Context* sb_init() {
   Arena* arena = new_arena();
 
@@ -28,14 +58,26 @@ SB_Context* sb_init() {
 }
 
 void sb_cleanup(SB_Context* ctx) {
+  for (int i = 0; i < vec_len(ctx->funcs); ++i) {
+    free_arena(ctx->funcs[i]->arena);
+    vec_free(ctx->funcs[i]->nodes);
+    free(ctx->funcs[i]->value_slots);
+  }
+
+  vec_free(ctx->funcs);
   free_arena(ctx->arena);
 }
 
 SB_Func* sb_begin_func(SB_Context* ctx) {
   SB_Func* func = arena_type(ctx->arena, SB_Func);
   func->context = ctx;
+  func->arena = new_arena();
   func->next_id = 1;
 
+  vec_put(func->nodes, NULL); // id 0 is never used
+
+  vec_put(ctx->funcs, func);
+
   return func;
 }
 
@@ -58,7 +100,7 @@ GraphWalk post_order_walk_ins(Arena* arena, SB_Func* func) {
   uint64_t* visited = arena_array(arena, uint64_t, bitset_num_u64(func->next_id));
 
   Vec(PostOrderNode) stack = NULL;
-  vec_put(stack, post_order_node(false, func->end));
+  vec_put(stack, post_order_node(false, sb_func_end(func)));
 
   while (vec_len(stack)) {
     PostOrderNode n = vec_pop(stack);
@@ -73,8 +115,10 @@ GraphWalk post_order_walk_ins(Arena* arena, SB_Func* func) {
       vec_put(stack, post_order_node(true, n.node));
 
       for (int32_t i = 0; i < n.node->num_ins; ++i) {
-        if (n.node->ins[i]) {
-          vec_put(stack, post_order_node(false, n.node->ins[i]));
+        SB_Node* input = sb_in(func, n.node, i);
+
+        if (input) {
+          vec_put(stack, post_order_node(false, input));
         }
       }
     }
@@ -100,21 +144,29 @@ void sb_finish_func(SB_Func* func) {
 
   GraphWalk walk = post_order_walk_ins(scratch.arena, func);
 
-  assert(bitset_get(walk.visited, func->start->id) && "function never terminates");
+  assert(bitset_get(walk.visited, func->start) && "function never terminates");
 
   for (size_t i = 0; i < walk.count; ++i) {
     SB_Node* node = walk.nodes[i];
 
-    for (SB_Use** use = &node->uses; *use;) {
-      if (!bitset_get(walk.visited, (*use)->node->id)) {
-        *use = (*use)->next;
+    for (int32_t j = 0; j < node->num_uses;) {
+      SB_Use* use = &node->uses[j];
+
+      if (!bitset_get(walk.visited, use->user)) {
+        sb_remove_use(func, sb_user(func, use), use->index);
       }
       else {
-        use = &(*use)->next;
+        ++j;
       }
     }
   }
 
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    if (func->nodes[id] && !bitset_get(walk.visited, id)) {
+      sb_kill_node(func, func->nodes[id]);
+    }
+  }
+
   scratch_release(&scratch);
 }
 
@@ -124,33 +176,29 @@ static const char* gv_label(SB_Node* node, char* buf, size_t buf_cap) {
       return sb_node_kind_label[node->kind];
     case SB_NODE_CONSTANT: {
       uint64_t value = DATA(node, ConstantData)->value;
-      snprintf(buf, buf_cap, "%lld", value);
+      snprintf(buf, buf_cap, "%lld", (long long)value);
       return buf;
     } break;
   }
 }
 
 void sb_graphviz_func(FILE* stream, SB_Func* func) {
-  Scratch scratch = scratch_get(0, NULL);
-
-  GraphWalk walk = post_order_walk_ins(scratch.arena, func);
-
   fprintf(stream, "digraph G {\n");
   fprintf(stream, "  rankdir=BT;\n");
 
   fprintf(stream, "  subgraph cluster {\n");
 
-  for (size_t i = 0; i < walk.count; ++i) {
-    SB_Node* node = walk.nodes[i];
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
 
-    if (node->flags & SB_FLAG_IS_PROJ) {
+    if (!node || node->flags & SB_FLAG_IS_PROJ) {
       continue;
     }
 
     bool has_proj = false;
 
-    for (SB_Use* use = node->uses; !has_proj && use; use = use->next) {
-      if (use->node->flags & SB_FLAG_IS_PROJ) {
+    for (int32_t j = 0; !has_proj && j < node->num_uses; ++j) {
+      if (sb_user(func, &node->uses[j])->flags & SB_FLAG_IS_PROJ) {
         has_proj = true;
       }
     }
@@ -177,14 +225,16 @@ void sb_graphviz_func(FILE* stream, SB_Func* func) {
       fprintf(stream, "<table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\">");
       fprintf(stream, "<tr>");
 
-      for (SB_Use* use = node->uses; use; use = use->next) {
-        if (!(use->node->flags & SB_FLAG_IS_PROJ)) {
+      for (int32_t j = 0; j < node->num_uses; ++j) {
+        SB_Node* user = sb_user(func, &node->uses[j]);
+
+        if (!(user->flags & SB_FLAG_IS_PROJ)) {
           continue;
         }
 
-        fprintf(stream, "<td%s", (use->node->flags & SB_FLAG_IS_CFG) ? " bgcolor=\"yellow\"" : "");
+        fprintf(stream, "<td%s", (user->flags & SB_FLAG_IS_CFG) ? " bgcolor=\"yellow\"" : "");
 
-        fprintf(stream, " port=\"p%s\">%s</td>", sb_node_kind_label[use->node->kind], sb_node_kind_label[use->node->kind]);
+        fprintf(stream, " port=\"p%s\">%s</td>", sb_node_kind_label[user->kind], sb_node_kind_label[user->kind]);
       }
 
       fprintf(stream, "</tr>");
@@ -197,21 +247,23 @@ void sb_graphviz_func(FILE* stream, SB_Func* func) {
     fprintf(stream, "];\n"); 
 
     for (int32_t j = 0; j < node->num_ins; ++j) {
-      if (!node->ins[j]) {
+      SB_Node* input = sb_in(func, node, j);
+
+      if (!input) {
         continue;
       }
 
-      if (node->ins[j]->kind == SB_NODE_START && !(node->flags & SB_FLAG_IS_PROJ)) {
+      if (input->kind == SB_NODE_START && !(node->flags & SB_FLAG_IS_PROJ)) {
         continue;
       }
 
       fprintf(stream, "    n%d -> ", node->id);
 
-      if (node->ins[j]->flags & SB_FLAG_IS_PROJ) {
-        fprintf(stream, "n%d:p%s", node->ins[j]->ins[0]->id, sb_node_kind_label[node->ins[j]->kind]);
+      if (input->flags & SB_FLAG_IS_PROJ) {
+        fprintf(stream, "n%d:p%s", input->ins[0], sb_node_kind_label[input->kind]);
       }
       else {
-        fprintf(stream, "n%d", node->ins[j]->id);
+        fprintf(stream, "n%d", input->id);
       }
 
       fprintf(stream, "[taillabel=\"%d\"];\n", j);
@@ -220,25 +272,77 @@ void sb_graphviz_func(FILE* stream, SB_Func* func) {
 
   fprintf(stream, "  }\n");
   fprintf(stream, "}\n\n");
+}
 
-  scratch_release(&scratch);
+static size_t ins_size(int32_t num_ins) {
+  // Input ids, then the matching use slots.
+  return num_ins * 2 * sizeof(int32_t);
+}
+
+static void place_ins(SB_Node* node, int32_t num_ins, void* storage) {
+  node->num_ins = num_ins;
+  node->ins = storage;
+  node->use_slots = ptr_byte_add(storage, num_ins * sizeof(int32_t));
 }
 
+// Only REGION and PHI learn their arity after creation, so they are the only
+// nodes whose inputs live outside the node allocation.
 static void init_ins(SB_Func* func, SB_Node* node, int32_t num_ins) {
   assert(node->ins == NULL);
-  node->num_ins = num_ins;
-  node->ins = arena_array(func->context->arena, SB_Node*, num_ins);
+  assert(node->kind == SB_NODE_REGION || node->kind == SB_NODE_PHI);
+  place_ins(node, num_ins, arena_zeroed(func->arena, ins_size(num_ins)));
+}
+
+void sb_add_use(SB_Func* func, SB_Node* def, SB_Node* user, int32_t index) {
+  if (def->num_uses == def->use_capacity) {
+    int32_t new_capacity = def->use_capacity * 2;
+    SB_Use* uses = arena_array(func->arena, SB_Use, new_capacity);
+
+    memcpy(uses, def->uses, def->num_uses * sizeof(SB_Use));
+
+    def->uses = uses;
+    def->use_capacity = new_capacity;
+  }
+
+  user->use_slots[index] = def->num_uses;
+
+  def->uses[def->num_uses++] = (SB_Use) {
+    .user = user->id,
+    .index = index
+  };
+}
+
+void sb_remove_use(SB_Func* func, SB_Node* user, int32_t index) {
+  SB_Node* def = sb_in(func, user, index);
+  int32_t slot = user->use_slots[index];
+
+  assert(slot < def->num_uses);
+  assert(def->uses[slot].user == user->id && def->uses[slot].index == index);
+
+  SB_Use last = def->uses[--def->num_uses];
+  def->uses[slot] = last;
+  sb_user(func, &last)->use_slots[last.index] = slot;
 }
 
 static SB_Node* new_node_with_data(SB_Func* func, SB_NodeKind kind, int32_t num_ins, size_t data_size) {
   assert(kind);
   assert(kind == SB_NODE_START || kind == SB_NODE_PHI || kind == SB_NODE_REGION || num_ins != 0);
 
-  SB_Node* node = arena_zeroed(func->context->arena, sizeof(SB_Node) + data_size);
+  // Layout is [SB_Node][data][ins][use_slots], one allocation per node.
+  size_t ins_offset = (sizeof(SB_Node) + data_size + 3) & ~(size_t)3;
+  SB_Node* node = arena_zeroed(func->arena, ins_offset + ins_size(num_ins));
 
   node->id = func->next_id++;
   node->kind = kind;
-  init_ins(func, node, num_ins);
+
+  vec_put(func->nodes, node);
+  func->num_live++;
+  node->uses = node->inline_uses;
+  node->use_capacity = SB_INLINE_USES;
+
+  if (num_ins) {
+    place_ins(node, num_ins, ptr_byte_add(node, ins_offset));
+  }
 
   return node;
 }
@@ -247,30 +351,300 @@ static SB_Node* new_node(SB_Func* func, SB_NodeKind kind, int32_t num_ins)  {
   return new_node_with_data(func, kind, num_ins, 0);
 }
 
-
 static void set_input(SB_Func* func, SB_Node* node, int32_t index, SB_Node* input) {
   assert(input);
   assert(!node->ins[index]);
 
   assert(index < node->num_ins);
 
-  node->ins[index] = input;
+  node->ins[index] = input->id;
+  sb_add_use(func, input, node, index);
+}
+
+// Value numbering. Pure data nodes with the same kind, inputs and payload
+// compute the same value, so the constructors hand back the node already in
+// the table instead of making a copy. DEAD carries no state either and is
+// shared the same way. A node's inputs must not change while it is in the
+// table, the optimizer takes it out first and numbers it again afterwards.
+
+static bool is_pure_value(SB_NodeKind kind) {
+  switch (kind) {
+    default:
+      return false;
+    case SB_NODE_NULL:
+    case SB_NODE_DEAD:
+    case SB_NODE_CONSTANT:
+    case SB_NODE_ADD:
+    case SB_NODE_SUB:
+    case SB_NODE_MUL:
+    case SB_NODE_SDIV:
+      return true;
+  }
+}
+
+static uint32_t value_hash(SB_NodeKind kind, int32_t num_ins, const int32_t* ins, const void* data) {
+  uint64_t hash = (uint64_t)kind * 0x9e3779b97f4a7c15ull;
+
+  for (int32_t i = 0; i < num_ins; ++i) {
+    hash = (hash ^ (uint64_t)ins[i]) * 0x9e3779b97f4a7c15ull;
+  }
+
+  size_t data_size = node_data_size(kind);
 
-  SB_Use* use = arena_type(func->context->arena, SB_Use);
-  use->node = node;
-  use->index = index;
+  for (size_t i = 0; i < data_size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, (const char*)data + i, sizeof(word));
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+  }
+
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static bool value_equal(SB_Node* node, SB_NodeKind kind, int32_t num_ins, const int32_t* ins, const void* data) {
+  if (node->kind != kind || node->num_ins != num_ins) {
+    return false;
+  }
+
+  for (int32_t i = 0; i < num_ins; ++i) {
+    if (node->ins[i] != ins[i]) {
+      return false;
+    }
+  }
 
-  use->next = input->uses;
-  input->uses = use;
+  // Constructors of kinds without a payload pass no data.
+  return !data || memcmp(node_data_raw(node), data, node_data_size(kind)) == 0;
+}
+
+// Returns the slot holding an equal node, or the empty slot it would go in.
+static uint32_t probe_value(SB_Func* func, uint32_t hash, SB_NodeKind kind, int32_t num_ins, const int32_t* ins, const void* data) {
+  uint32_t i = hash & func->value_mask;
+
+  while (func->value_slots[i].node) {
+    SB_ValueSlot* slot = &func->value_slots[i];
+
+    if (slot->hash == hash && value_equal(func->nodes[slot->node], kind, num_ins, ins, data)) {
+      break;
+    }
+
+    i = (i + 1) & func->value_mask;
+  }
+
+  return i;
+}
+
+static void grow_value_table(SB_Func* func) {
+  SB_ValueSlot* old_slots = func->value_slots;
+  uint32_t old_count = old_slots ? func->value_mask + 1 : 0;
+  uint32_t new_count = old_count ? old_count * 2 : VALUE_TABLE_INITIAL_SLOTS;
+
+  func->value_slots = calloc(new_count, sizeof(SB_ValueSlot));
+  func->value_mask = new_count - 1;
+
+  for (uint32_t i = 0; i < old_count; ++i) {
+    if (!old_slots[i].node) {
+      continue;
+    }
+
+    uint32_t j = old_slots[i].hash & func->value_mask;
+
+    while (func->value_slots[j].node) {
+      j = (j + 1) & func->value_mask;
+    }
+
+    func->value_slots[j] = old_slots[i];
+  }
+
+  free(old_slots);
+}
+
+static SB_Node* find_value(SB_Func* func, SB_NodeKind kind, int32_t num_ins, const int32_t* ins, const void* data) {
+  if (!func->value_slots) {
+    return NULL;
+  }
+
+  uint32_t hash = value_hash(kind, num_ins, ins, data);
+  return func->nodes[func->value_slots[probe_value(func, hash, kind, num_ins, ins, data)].node];
+}
+
+SB_Node* sb_value_number(SB_Func* func, SB_Node* node) {
+  if (!is_pure_value(node->kind) || (node->flags & SB_FLAG_IN_VALUE_TABLE)) {
+    return node;
+  }
+
+  if (!func->value_slots || (uint32_t)(func->num_values + 1) * 2 > func->value_mask + 1) {
+    grow_value_table(func);
+  }
+
+  void* data = node_data_raw(node);
+  uint32_t hash = value_hash(node->kind, node->num_ins, node->ins, data);
+
+  SB_ValueSlot* slot = &func->value_slots[probe_value(func, hash, node->kind, node->num_ins, node->ins, data)];
+
+  if (slot->node) {
+    return func->nodes[slot->node];
+  }
+
+  slot->hash = hash;
+  slot->node = node->id;
+
+  func->num_values++;
+  node->flags |= SB_FLAG_IN_VALUE_TABLE;
+
+  return node;
+}
+
+// Backward-shift deletion, as in the checker's symbol table.
+void sb_forget_value(SB_Func* func, SB_Node* node) {
+  if (!(node->flags & SB_FLAG_IN_VALUE_TABLE)) {
+    return;
+  }
+
+  node->flags &= ~SB_FLAG_IN_VALUE_TABLE;
+
+  uint32_t hash = value_hash(node->kind, node->num_ins, node->ins, node_data_raw(node));
+  uint32_t hole = hash & func->value_mask;
+
+  while (func->value_slots[hole].node != node->id) {
+    assert(func->value_slots[hole].node);
+    hole = (hole + 1) & func->value_mask;
+  }
+
+  uint32_t i = hole;
+
+  while (true) {
+    i = (i + 1) & func->value_mask;
+
+    if (!func->value_slots[i].node) {
+      break;
+    }
+
+    uint32_t home = func->value_slots[i].hash & func->value_mask;
+
+    if (((i - home) & func->value_mask) >= ((i - hole) & func->value_mask)) {
+      func->value_slots[hole] = func->value_slots[i];
+      hole = i;
+    }
+  }
+
+  func->value_slots[hole].node = 0;
+  func->num_values--;
+}
+
+void sb_kill_node(SB_Func* func, SB_Node* node) {
+  assert(func->nodes[node->id] == node);
+  sb_forget_value(func, node);
+  func->nodes[node->id] = NULL;
+  func->num_live--;
+}
+
+bool sb_should_compact(SB_Func* func) {
+  int32_t num_ids = func->next_id - 1;
+  int32_t num_dead = num_ids - func->num_live;
+  return num_ids >= COMPACT_MIN_NODES && num_dead >= num_ids * COMPACT_DEAD_FRACTION;
+}
+
+void sb_compact_func(SB_Func* func) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  SB_Func fresh = {
+    .context = func->context,
+    .arena = new_arena(),
+    .next_id = 1
+  };
+
+  vec_put(fresh.nodes, NULL);
+
+  SB_Node** remap = arena_array(scratch.arena, SB_Node*, func->next_id);
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (!node) {
+      continue;
+    }
+
+    bool variadic = node->kind == SB_NODE_REGION || node->kind == SB_NODE_PHI;
+    size_t data_size = node_data_size(node->kind);
+
+    SB_Node* copy = new_node_with_data(&fresh, node->kind, variadic ? 0 : node->num_ins, data_size);
+    copy->flags = node->flags;
+
+    if (variadic && node->num_ins) {
+      init_ins(&fresh, copy, node->num_ins);
+    }
+
+    memcpy(node_data_raw(copy), node_data_raw(node), data_size);
+
+    remap[id] = copy;
+  }
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (!node) {
+      continue;
+    }
+
+    SB_Node* copy = remap[id];
+
+    for (int32_t i = 0; i < node->num_ins; ++i) {
+      if (node->ins[i]) {
+        set_input(&fresh, copy, i, remap[node->ins[i]]);
+      }
+    }
+  }
+
+  fresh.start = remap[func->start]->id;
+  fresh.end = remap[func->end]->id;
+
+  // The copies have new ids, so their hashes change with them.
+  for (int32_t id = 1; id < fresh.next_id; ++id) {
+    SB_Node* copy = fresh.nodes[id];
+
+    if (copy->flags & SB_FLAG_IN_VALUE_TABLE) {
+      copy->flags &= ~SB_FLAG_IN_VALUE_TABLE;
+      sb_value_number(&fresh, copy);
+    }
+  }
+
+  free_arena(func->arena);
+  vec_free(func->nodes);
+  free(func->value_slots);
+
+  *func = fresh;
+
+  scratch_release(&scratch);
 }
 
 static SB_Node* new_leaf(SB_Func* func, SB_NodeKind kind, size_t data_size) {
   assert(func->start);
   SB_Node* node = new_node_with_data(func, kind, 1, data_size);
-  set_input(func, node, 0, func->start);
+  set_input(func, node, 0, sb_func_start(func));
   return node;
 }
 
+// Pure data nodes go through the value table, see sb_value_number().
+static SB_Node* new_value(SB_Func* func, SB_NodeKind kind, int32_t num_ins, const int32_t* ins, const void* data) {
+  SB_Node* existing = find_value(func, kind, num_ins, ins, data);
+
+  if (existing) {
+    return existing;
+  }
+
+  size_t data_size = node_data_size(kind);
+  SB_Node* node = new_node_with_data(func, kind, num_ins, data_size);
+
+  for (int32_t i = 0; i < num_ins; ++i) {
+    set_input(func, node, i, func->nodes[ins[i]]);
+  }
+
+  if (data_size) {
+    memcpy(node_data_raw(node), data, data_size);
+  }
+
+  return sb_value_number(func, node);
+}
+
 static SB_Node* new_proj(SB_Func* func, SB_NodeKind kind, SB_Node* parent) {
   SB_Node* node = new_node(func, kind, 1);
   node->flags |= SB_FLAG_IS_PROJ;
@@ -280,9 +654,10 @@ static SB_Node* new_proj(SB_Func* func, SB_NodeKind kind, SB_Node* parent) {
 
 SB_Node* sb_node_start(SB_Func* func) {
   assert(!func->start);
-  func->start = new_node(func, SB_NODE_START, 0);
-  func->start->flags |= SB_FLAG_IS_CFG;
-  return func->start;
+  SB_Node* node = new_node(func, SB_NODE_START, 0);
+  node->flags |= SB_FLAG_IS_CFG;
+  func->start = node->id;
+  return node;
 }
 
 SB_Node* sb_node_start_ctrl(SB_Func* func, SB_Node* start) {
@@ -308,13 +683,21 @@ SB_Node* sb_node_end(SB_Func* func, SB_Node* ctrl, SB_Node* mem, SB_Node* return
 
   node->flags |= SB_FLAG_IS_CFG;
 
-  func->end = node;
+  func->end = node->id;
 
   return node;
 }
 
 SB_Node* sb_node_null(SB_Func* func) {
-  return new_leaf(func, SB_NODE_NULL, 0);
+  assert(func->start);
+  return new_value(func, SB_NODE_NULL, 1, &func->start, NULL);
+}
+
+SB_Node* sb_node_dead(SB_Func* func) {
+  assert(func->start);
+  SB_Node* node = new_value(func, SB_NODE_DEAD, 1, &func->start, NULL);
+  node->flags |= SB_FLAG_IS_CFG;
+  return node;
 }
 
 SB_Node* sb_node_region(SB_Func* func) {
@@ -407,16 +790,23 @@ SB_Node* sb_node_alloca(SB_Func* func) {
 }
 
 SB_Node* sb_node_constant(SB_Func* func, uint64_t value) {
-  SB_Node* node = new_leaf(func, SB_NODE_CONSTANT, sizeof(ConstantData));
-  DATA(node, ConstantData)->value = value;
-  return node;
+  assert(func->start);
+
+  ConstantData data = {
+    .value = value
+  };
+
+  return new_value(func, SB_NODE_CONSTANT, 1, &func->start, &data);
+}
+
+uint64_t sb_constant_value(SB_Node* node) {
+  assert(node->kind == SB_NODE_CONSTANT);
+  return DATA(node, ConstantData)->value;
 }
 
 static SB_Node* new_binary_node(SB_Func* func, SB_NodeKind kind, SB_Node* lhs, SB_Node* rhs) {
-  SB_Node* node = new_node(func, kind, 2);
-  set_input(func, node, 0, lhs);
-  set_input(func, node, 1, rhs);
-  return node;
+  int32_t ins[] = { lhs->id, rhs->id };
+  return new_value(func, kind, 2, ins, NULL);
 }
 
 SB_Node* sb_node_add(SB_Func* func, SB_Node* lhs, SB_Node* rhs) {
@@ -0,0 +1,262 @@
+#include "spindle.h"
+
+#include "utility.h"
+#include "internal.h"
+
+// Dominators by Cooper, Harvey and Kennedy, "A Simple, Fast Dominance
+// Algorithm", run directly on the CFG nodes. Loops are the natural loops of
+// back edges into regions, nested by walking the headers innermost first.
+
+// DEAD hangs off START as a leaf, it is not reached by any control edge.
+static bool is_cfg_edge(SB_Node* user, int32_t index) {
+  if (!(user->flags & SB_FLAG_IS_CFG) || user->kind == SB_NODE_DEAD) {
+    return false;
+  }
+
+  return user->kind == SB_NODE_REGION || index == 0;
+}
+
+static int32_t num_cfg_preds(SB_Node* node) {
+  switch (node->kind) {
+    case SB_NODE_START:
+      return 0;
+    case SB_NODE_REGION:
+      return node->num_ins;
+    default:
+      return 1;
+  }
+}
+
+static SB_Node* cfg_pred(SB_Func* func, SB_DomInfo* info, SB_Node* node, int32_t index) {
+  SB_Node* pred = sb_in(func, node, index);
+  return pred && info->rpo_index[pred->id] >= 0 ? pred : NULL;
+}
+
+typedef struct {
+  SB_Node* node;
+  int32_t next_use;
+} DfsFrame;
+
+static void compute_rpo(Arena* arena, SB_Func* func, SB_DomInfo* info) {
+  Scratch scratch = scratch_get(1, &arena);
+
+  SB_Node** post_order = arena_array(scratch.arena, SB_Node*, func->next_id);
+  int32_t count = 0;
+
+  Vec(DfsFrame) stack = NULL;
+  vec_in_arena(stack, scratch.arena);
+
+  // rpo_index doubles as the visited mark until the real numbers go in.
+  info->rpo_index[func->start] = 0;
+  vec_put(stack, ((DfsFrame) { .node = sb_func_start(func) }));
+
+  while (vec_len(stack)) {
+    DfsFrame* frame = &stack[vec_len(stack) - 1];
+    SB_Node* node = frame->node;
+
+    if (frame->next_use == node->num_uses) {
+      post_order[count++] = node;
+      (void)vec_pop(stack);
+      continue;
+    }
+
+    SB_Use* use = &node->uses[frame->next_use++];
+    SB_Node* user = sb_user(func, use);
+
+    if (is_cfg_edge(user, use->index) && info->rpo_index[user->id] < 0) {
+      info->rpo_index[user->id] = 0;
+      vec_put(stack, ((DfsFrame) { .node = user }));
+    }
+  }
+
+  info->num_cfg = count;
+  info->rpo = arena_array(arena, SB_Node*, count);
+
+  for (int32_t i = 0; i < count; ++i) {
+    SB_Node* node = post_order[count - 1 - i];
+    info->rpo[i] = node;
+    info->rpo_index[node->id] = i;
+  }
+
+  scratch_release(&scratch);
+}
+
+static SB_Node* intersect(SB_DomInfo* info, SB_Node* a, SB_Node* b) {
+  while (a != b) {
+    while (info->rpo_index[a->id] > info->rpo_index[b->id]) {
+      a = info->idom[a->id];
+    }
+
+    while (info->rpo_index[b->id] > info->rpo_index[a->id]) {
+      b = info->idom[b->id];
+    }
+  }
+
+  return a;
+}
+
+static void compute_idoms(SB_Func* func, SB_DomInfo* info) {
+  info->idom[func->start] = sb_func_start(func);
+
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (int32_t i = 1; i < info->num_cfg; ++i) {
+      SB_Node* node = info->rpo[i];
+      SB_Node* new_idom = NULL;
+
+      for (int32_t j = 0; j < num_cfg_preds(node); ++j) {
+        SB_Node* pred = cfg_pred(func, info, node, j);
+
+        if (!pred || !info->idom[pred->id]) {
+          continue;
+        }
+
+        new_idom = new_idom ? intersect(info, pred, new_idom) : pred;
+      }
+
+      if (info->idom[node->id] != new_idom) {
+        info->idom[node->id] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  // In RPO every idom is numbered before the nodes it dominates.
+  for (int32_t i = 1; i < info->num_cfg; ++i) {
+    SB_Node* node = info->rpo[i];
+    info->dom_depth[node->id] = info->dom_depth[info->idom[node->id]->id] + 1;
+  }
+
+  info->idom[func->start] = NULL;
+}
+
+// Outermost loop 'loop' has been folded into so far.
+static int32_t outermost_loop(SB_DomInfo* info, int32_t loop) {
+  while (info->loops[loop].parent >= 0) {
+    loop = info->loops[loop].parent;
+  }
+
+  return loop;
+}
+
+// Headers are visited innermost first, the reverse of RPO. The body of each
+// loop is found by walking back from its latches. Reaching a node that
+// already belongs to a loop means that loop nests inside this one, so the
+// walk jumps straight to its header instead of revisiting its body.
+static void compute_loops(Arena* arena, SB_Func* func, SB_DomInfo* info) {
+  Scratch scratch = scratch_get(1, &arena);
+
+  Vec(SB_Loop) loops = NULL;
+  vec_in_arena(loops, scratch.arena);
+
+  Vec(SB_Node*) stack = NULL;
+  vec_in_arena(stack, scratch.arena);
+
+  for (int32_t i = info->num_cfg - 1; i >= 0; --i) {
+    SB_Node* header = info->rpo[i];
+
+    if (header->kind != SB_NODE_REGION) {
+      continue;
+    }
+
+    vec_clear(stack);
+
+    for (int32_t j = 0; j < header->num_ins; ++j) {
+      SB_Node* pred = cfg_pred(func, info, header, j);
+
+      if (pred && sb_dominates(info, header, pred)) {
+        vec_put(stack, pred);
+      }
+    }
+
+    if (vec_len(stack) == 0) {
+      continue;
+    }
+
+    int32_t loop = vec_len(loops);
+
+    vec_put(loops, ((SB_Loop) {
+      .header = header,
+      .parent = -1
+    }));
+
+    info->loops = loops;
+    info->loop[header->id] = loop;
+
+    while (vec_len(stack)) {
+      SB_Node* node = vec_pop(stack);
+
+      if (info->loop[node->id] < 0) {
+        info->loop[node->id] = loop;
+      }
+      else {
+        int32_t inner = outermost_loop(info, info->loop[node->id]);
+
+        if (inner == loop) {
+          continue;
+        }
+
+        loops[inner].parent = loop;
+        node = loops[inner].header;
+      }
+
+      for (int32_t j = 0; j < num_cfg_preds(node); ++j) {
+        SB_Node* pred = cfg_pred(func, info, node, j);
+
+        if (pred) {
+          vec_put(stack, pred);
+        }
+      }
+    }
+  }
+
+  info->num_loops = vec_len(loops);
+  info->loops = info->num_loops ? arena_array(arena, SB_Loop, info->num_loops) : NULL;
+
+  // Parents are always found after their children.
+  for (int32_t i = info->num_loops - 1; i >= 0; --i) {
+    SB_Loop loop = loops[i];
+    loop.depth = loop.parent < 0 ? 1 : info->loops[loop.parent].depth + 1;
+    info->loops[i] = loop;
+  }
+
+  scratch_release(&scratch);
+}
+
+SB_DomInfo sb_compute_dominators(Arena* arena, SB_Func* func) {
+  SB_DomInfo info = {
+    .rpo_index = arena_push(arena, func->next_id * sizeof(int32_t)),
+    .idom = arena_array(arena, SB_Node*, func->next_id),
+    .dom_depth = arena_array(arena, int32_t, func->next_id),
+    .loop = arena_push(arena, func->next_id * sizeof(int32_t))
+  };
+
+  for (int32_t id = 0; id < func->next_id; ++id) {
+    info.rpo_index[id] = -1;
+    info.loop[id] = -1;
+  }
+
+  compute_rpo(arena, func, &info);
+  compute_idoms(func, &info);
+  compute_loops(arena, func, &info);
+
+  return info;
+}
+
+bool sb_dominates(SB_DomInfo* info, SB_Node* a, SB_Node* b) {
+  assert(info->rpo_index[a->id] >= 0 && info->rpo_index[b->id] >= 0);
+
+  while (info->dom_depth[b->id] > info->dom_depth[a->id]) {
+    b = info->idom[b->id];
+  }
+
+  return a == b;
+}
+
+int32_t sb_loop_depth(SB_DomInfo* info, SB_Node* node) {
+  int32_t loop = info->loop[node->id];
+  return loop < 0 ? 0 : info->loops[loop].depth;
+}
\ No newline at end of file
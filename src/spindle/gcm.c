@@ -0,0 +1,537 @@
+#include <stdio.h>
+
+#include "spindle.h"
+#include "utility.h"
+#include "internal.h"
+
+// Global code motion after Click, "Global Code Motion / Global Value
+// Numbering". Pinned nodes stay at their control. Every other node is placed
+// as early as its inputs allow, then as late as its uses allow, and finally
+// at the shallowest loop depth on the dominator path between the two.
+
+typedef struct {
+  SB_Func* func;
+  SB_DomInfo dom;
+
+  GraphWalk walk;        // live nodes, inputs before users
+  SB_Node** place;       // by id, the CFG node a node is scheduled at
+  uint64_t* scheduled;   // by id, set once 'place' is final
+} Scheduler;
+
+static bool is_block_head(SB_Node* node) {
+  switch (node->kind) {
+    default:
+      return false;
+    case SB_NODE_START:
+    case SB_NODE_REGION:
+    case SB_NODE_BRANCH_TRUE:
+    case SB_NODE_BRANCH_FALSE:
+      return true;
+  }
+}
+
+static bool is_cfg_reached(Scheduler* s, SB_Node* node) {
+  return node && (node->flags & SB_FLAG_IS_CFG) && s->dom.rpo_index[node->id] >= 0;
+}
+
+// Loads and stores are pinned by their control input, a phi by its region
+// and the start projections by START.
+static SB_Node* pinned_at(SB_Func* func, SB_Node* node) {
+  if (node->flags & SB_FLAG_IS_CFG) {
+    return node;
+  }
+
+  switch (node->kind) {
+    default:
+      return NULL;
+    case SB_NODE_PHI:
+    case SB_NODE_START_MEM:
+    case SB_NODE_LOAD:
+    case SB_NODE_STORE:
+      return sb_in(func, node, 0);
+  }
+}
+
+static SB_Node* dom_lca(SB_DomInfo* dom, SB_Node* a, SB_Node* b) {
+  if (!a) {
+    return b;
+  }
+
+  while (a != b) {
+    if (dom->dom_depth[a->id] >= dom->dom_depth[b->id]) {
+      a = dom->idom[a->id];
+    }
+    else {
+      b = dom->idom[b->id];
+    }
+  }
+
+  return a;
+}
+
+static void schedule_pinned(Scheduler* s) {
+  for (size_t i = 0; i < s->walk.count; ++i) {
+    SB_Node* node = s->walk.nodes[i];
+    SB_Node* pin = pinned_at(s->func, node);
+
+    if (pin && is_cfg_reached(s, pin)) {
+      s->place[node->id] = pin;
+      bitset_set(s->scheduled, node->id);
+    }
+  }
+}
+
+// A node on the explicit stack of a depth-first pass, and the next input or
+// use to visit.
+typedef struct {
+  SB_Node* node;
+  int32_t next;
+} Frame;
+
+// Depth-first over inputs from each pinned node, stopping at the next pinned
+// one. Every cycle runs through a phi, so a floating node is only finished
+// after all of its inputs have a block. The deepest of them in the dominator
+// tree is the earliest block where all of them are available.
+static void schedule_early(Scheduler* s) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  SB_Func* func = s->func;
+  SB_DomInfo* dom = &s->dom;
+
+  uint64_t* visited = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id));
+
+  Vec(Frame) stack = NULL;
+  vec_in_arena(stack, scratch.arena);
+
+  for (size_t i = 0; i < s->walk.count; ++i) {
+    SB_Node* root = s->walk.nodes[i];
+
+    if (!bitset_get(s->scheduled, root->id)) {
+      continue;
+    }
+
+    vec_put(stack, ((Frame) { .node = root }));
+
+    while (vec_len(stack)) {
+      Frame* frame = &stack[vec_len(stack) - 1];
+      SB_Node* node = frame->node;
+
+      if (frame->next < node->num_ins) {
+        SB_Node* input = sb_in(func, node, frame->next++);
+
+        if (input && !pinned_at(func, input) && !bitset_get(visited, input->id)) {
+          bitset_set(visited, input->id);
+          vec_put(stack, ((Frame) { .node = input }));
+        }
+
+        continue;
+      }
+
+      (void)vec_pop(stack);
+
+      if (pinned_at(func, node)) {
+        continue;
+      }
+
+      SB_Node* early = sb_func_start(func);
+
+      for (int32_t j = 0; j < node->num_ins; ++j) {
+        SB_Node* input = sb_in(func, node, j);
+        SB_Node* at = input ? s->place[input->id] : NULL;
+
+        if (at && dom->dom_depth[at->id] > dom->dom_depth[early->id]) {
+          early = at;
+        }
+      }
+
+      s->place[node->id] = early;
+    }
+  }
+
+  scratch_release(&scratch);
+}
+
+// The block a use needs 'node' in. A phi needs it at the end of the
+// matching region input, not in the region itself.
+static SB_Node* use_block(Scheduler* s, SB_Use* use) {
+  SB_Node* user = sb_user(s->func, use);
+
+  if (!bitset_get(s->scheduled, user->id)) {
+    return NULL;
+  }
+
+  if (user->kind == SB_NODE_PHI) {
+    SB_Node* pred = sb_in(s->func, sb_in(s->func, user, 0), use->index - 1);
+    return is_cfg_reached(s, pred) ? pred : NULL;
+  }
+
+  return s->place[user->id];
+}
+
+// A division traps on a zero divisor, so it only leaves a loop, which may
+// not run at all, when the divisor is a constant other than zero.
+static bool can_hoist(SB_Func* func, SB_Node* node) {
+  if (node->kind != SB_NODE_SDIV) {
+    return true;
+  }
+
+  SB_Node* divisor = sb_in(func, node, 1);
+  return divisor->kind == SB_NODE_CONSTANT && sb_constant_value(divisor) != 0;
+}
+
+// The LCA of all use blocks is the latest legal block, from there walk up to
+// the early block and keep the one with the least loop depth.
+static void place_late(Scheduler* s, SB_Node* node) {
+  SB_DomInfo* dom = &s->dom;
+
+  SB_Node* early = s->place[node->id];
+  SB_Node* late = NULL;
+
+  for (int32_t i = 0; i < node->num_uses; ++i) {
+    SB_Node* at = use_block(s, &node->uses[i]);
+
+    if (at) {
+      late = dom_lca(dom, late, at);
+    }
+  }
+
+  // Only unreachable code uses it.
+  if (!late) {
+    return;
+  }
+
+  SB_Node* best = late;
+  bool hoist = can_hoist(s->func, node);
+
+  for (SB_Node* at = late; at != early;) {
+    at = dom->idom[at->id];
+    assert(at && "early block does not dominate late block");
+
+    if (hoist && sb_loop_depth(dom, at) < sb_loop_depth(dom, best)) {
+      best = at;
+    }
+  }
+
+  s->place[node->id] = best;
+  bitset_set(s->scheduled, node->id);
+}
+
+// Depth-first over uses from each pinned node, stopping at the next pinned
+// one, so every floating user of a node is final before the node itself.
+// Users the early pass never reached are dead.
+static void schedule_late(Scheduler* s) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  SB_Func* func = s->func;
+
+  uint64_t* visited = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id));
+
+  Vec(Frame) stack = NULL;
+  vec_in_arena(stack, scratch.arena);
+
+  for (size_t i = 0; i < s->walk.count; ++i) {
+    SB_Node* root = s->walk.nodes[i];
+
+    if (!bitset_get(s->scheduled, root->id)) {
+      continue;
+    }
+
+    vec_put(stack, ((Frame) { .node = root }));
+
+    while (vec_len(stack)) {
+      Frame* frame = &stack[vec_len(stack) - 1];
+      SB_Node* node = frame->node;
+
+      if (frame->next < node->num_uses) {
+        SB_Node* user = sb_user(func, &node->uses[frame->next++]);
+
+        if (s->place[user->id] && !pinned_at(func, user) && !bitset_get(visited, user->id)) {
+          bitset_set(visited, user->id);
+          vec_put(stack, ((Frame) { .node = user }));
+        }
+
+        continue;
+      }
+
+      (void)vec_pop(stack);
+
+      if (!pinned_at(func, node)) {
+        place_late(s, node);
+      }
+    }
+  }
+
+  scratch_release(&scratch);
+}
+
+// Nodes that must come before 'node' inside its block: its inputs, and for
+// a store every load that still reads the memory it overwrites.
+static int32_t num_local_deps(SB_Func* func, SB_Node* node) {
+  int32_t count = node->num_ins;
+
+  if (node->kind == SB_NODE_STORE) {
+    count += sb_in(func, node, 1)->num_uses;
+  }
+
+  return count;
+}
+
+static SB_Node* local_dep(Scheduler* s, SB_Node* node, int32_t index) {
+  if (index < node->num_ins) {
+    return sb_in(s->func, node, index);
+  }
+
+  SB_Node* reader = sb_user(s->func, &sb_in(s->func, node, 1)->uses[index - node->num_ins]);
+  return reader->kind == SB_NODE_LOAD ? reader : NULL;
+}
+
+static SB_Schedule build_blocks(Arena* arena, Scheduler* s) {
+  Scratch scratch = scratch_get(1, &arena);
+
+  SB_Func* func = s->func;
+  SB_DomInfo* dom = &s->dom;
+
+  SB_Schedule schedule = {
+    .block_of = arena_push(arena, func->next_id * sizeof(int32_t))
+  };
+
+  for (int32_t id = 0; id < func->next_id; ++id) {
+    schedule.block_of[id] = -1;
+  }
+
+  // Block heads in RPO are the blocks. Any other CFG node belongs to the
+  // block of its control input, which comes earlier in RPO.
+  for (int32_t i = 0; i < dom->num_cfg; ++i) {
+    SB_Node* node = dom->rpo[i];
+
+    if (is_block_head(node)) {
+      schedule.block_of[node->id] = schedule.num_blocks++;
+    }
+    else {
+      schedule.block_of[node->id] = schedule.block_of[sb_in(s->func, node, 0)->id];
+    }
+  }
+
+  schedule.blocks = arena_array(arena, SB_Block, schedule.num_blocks);
+
+  for (int32_t i = 0; i < dom->num_cfg; ++i) {
+    SB_Node* node = dom->rpo[i];
+    SB_Block* block = &schedule.blocks[schedule.block_of[node->id]];
+
+    if (is_block_head(node)) {
+      block->head = node;
+    }
+
+    // The last CFG node of a block in RPO ends it.
+    block->tail = node;
+  }
+
+  int32_t* counts = arena_array(scratch.arena, int32_t, schedule.num_blocks);
+
+  for (size_t i = 0; i < s->walk.count; ++i) {
+    SB_Node* node = s->walk.nodes[i];
+
+    if (!bitset_get(s->scheduled, node->id) || (node->flags & SB_FLAG_IS_CFG)) {
+      continue;
+    }
+
+    int32_t block = schedule.block_of[s->place[node->id]->id];
+    schedule.block_of[node->id] = block;
+    counts[block]++;
+  }
+
+  for (int32_t b = 0; b < schedule.num_blocks; ++b) {
+    SB_Block* block = &schedule.blocks[b];
+
+    // Room for the terminator as well.
+    block->nodes = arena_array(arena, SB_Node*, counts[b] + 1);
+
+    for (int32_t j = 0; j < block->head->num_uses; ++j) {
+      SB_Node* user = sb_user(func, &block->head->uses[j]);
+
+      if (user->kind == SB_NODE_PHI && schedule.block_of[user->id] == b) {
+        block->nodes[block->num_nodes++] = user;
+      }
+    }
+  }
+
+  // Depth-first over local dependencies gives each block a valid order.
+  uint64_t* emitted = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id));
+
+  Vec(Frame) stack = NULL;
+  vec_in_arena(stack, scratch.arena);
+
+  for (size_t i = 0; i <= s->walk.count; ++i) {
+    // The terminators go last, after everything else is placed.
+    SB_Node* root = i < s->walk.count ? s->walk.nodes[i] : NULL;
+
+    if (root && (root->kind == SB_NODE_PHI || (root->flags & SB_FLAG_IS_CFG))) {
+      continue;
+    }
+
+    if (!root) {
+      for (int32_t b = 0; b < schedule.num_blocks; ++b) {
+        SB_Node* tail = schedule.blocks[b].tail;
+
+        if (tail->kind == SB_NODE_BRANCH || tail->kind == SB_NODE_END) {
+          vec_put(stack, ((Frame) { .node = tail }));
+        }
+      }
+    }
+    else if (schedule.block_of[root->id] >= 0) {
+      vec_put(stack, ((Frame) { .node = root }));
+    }
+
+    while (vec_len(stack)) {
+      Frame* frame = &stack[vec_len(stack) - 1];
+      SB_Node* node = frame->node;
+
+      if (frame->next == 0) {
+        if (bitset_get(emitted, node->id)) {
+          (void)vec_pop(stack);
+          continue;
+        }
+
+        bitset_set(emitted, node->id);
+      }
+
+      if (frame->next < num_local_deps(func, node)) {
+        SB_Node* dep = local_dep(s, node, frame->next++);
+
+        bool local = dep && !(dep->flags & SB_FLAG_IS_CFG) && dep->kind != SB_NODE_PHI
+          && schedule.block_of[dep->id] == schedule.block_of[node->id];
+
+        if (local && !bitset_get(emitted, dep->id)) {
+          vec_put(stack, ((Frame) { .node = dep }));
+        }
+
+        continue;
+      }
+
+      SB_Block* block = &schedule.blocks[schedule.block_of[node->id]];
+      block->nodes[block->num_nodes++] = node;
+
+      (void)vec_pop(stack);
+    }
+  }
+
+  scratch_release(&scratch);
+
+  return schedule;
+}
+
+SB_Schedule sb_schedule_func(Arena* arena, SB_Func* func) {
+  Scratch scratch = scratch_get(1, &arena);
+
+  Scheduler s = {
+    .func = func,
+    .dom = sb_compute_dominators(scratch.arena, func),
+    .walk = post_order_walk_ins(scratch.arena, func),
+    .place = arena_array(scratch.arena, SB_Node*, func->next_id),
+    .scheduled = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id))
+  };
+
+  schedule_pinned(&s);
+  schedule_early(&s);
+  schedule_late(&s);
+
+  SB_Schedule schedule = build_blocks(arena, &s);
+
+  scratch_release(&scratch);
+
+  return schedule;
+}
+
+static void print_block_ref(FILE* stream, SB_Schedule* schedule, SB_Node* head) {
+  fprintf(stream, "bb_%d", schedule->block_of[head->id]);
+}
+
+void sb_print_schedule(FILE* stream, SB_Func* func, SB_Schedule* schedule) {
+  for (int32_t b = 0; b < schedule->num_blocks; ++b) {
+    SB_Block* block = &schedule->blocks[b];
+
+    fprintf(stream, "bb_%d:\n", b);
+
+    for (int32_t i = 0; i < block->num_nodes; ++i) {
+      SB_Node* node = block->nodes[i];
+
+      fprintf(stream, "  ");
+
+      if (node->flags & SB_FLAG_IS_CFG) {
+        fprintf(stream, "%7s", "");
+      }
+      else {
+        fprintf(stream, "n%-4d = ", node->id);
+      }
+
+      fprintf(stream, "%s", sb_node_kind_label[node->kind]);
+
+      bool first = true;
+
+      // Control inputs are implied by the block.
+      for (int32_t j = 0; j < node->num_ins; ++j) {
+        SB_Node* input = sb_in(func, node, j);
+
+        if (!input || (input->flags & SB_FLAG_IS_CFG)) {
+          continue;
+        }
+
+        fprintf(stream, first ? " n%d" : ", n%d", input->id);
+        first = false;
+      }
+
+      if (node->kind == SB_NODE_CONSTANT) {
+        fprintf(stream, " %lld", (long long)sb_constant_value(node));
+      }
+
+      if (node->kind == SB_NODE_BRANCH) {
+        SB_Node* targets[2] = {0};
+
+        for (int32_t j = 0; j < node->num_uses; ++j) {
+          SB_Node* proj = sb_user(func, &node->uses[j]);
+
+          if (schedule->block_of[proj->id] >= 0) {
+            targets[proj->kind == SB_NODE_BRANCH_FALSE] = proj;
+          }
+        }
+
+        fprintf(stream, " [");
+
+        for (int j = 0; j < 2; ++j) {
+          if (j > 0) {
+            fprintf(stream, ", ");
+          }
+
+          if (targets[j]) {
+            print_block_ref(stream, schedule, targets[j]);
+          }
+          else {
+            fprintf(stream, "-");
+          }
+        }
+
+        fprintf(stream, "]");
+      }
+
+      fprintf(stream, "\n");
+    }
+
+    // A block that does not end in a branch or END falls into a region.
+    SB_Node* tail = block->tail;
+
+    if (tail->kind != SB_NODE_BRANCH && tail->kind != SB_NODE_END) {
+      for (int32_t j = 0; j < tail->num_uses; ++j) {
+        SB_Node* user = sb_user(func, &tail->uses[j]);
+
+        if (user->kind == SB_NODE_REGION && schedule->block_of[user->id] >= 0) {
+          fprintf(stream, "%9sgoto ", "");
+          print_block_ref(stream, schedule, user);
+          fprintf(stream, "\n");
+          break;
+        }
+      }
+    }
+  }
+
+  fprintf(stream, "\n");
+}
\ No newline at end of file
@@ -9,4 +9,66 @@ typedef struct {
   uint64_t* visited;
 } GraphWalk;
 
-GraphWalk post_order_walk_ins(Arena* arena, SB_Func* func);
\ No newline at end of file
+GraphWalk post_order_walk_ins(Arena* arena, SB_Func* func);
+
+void sb_kill_node(SB_Func* func, SB_Node* node);
+
+// Returns the node already in the value table that 'node' duplicates, or
+// enters 'node' and returns it. Nodes that are not pure values are returned
+// unchanged.
+SB_Node* sb_value_number(SB_Func* func, SB_Node* node);
+
+// Takes 'node' out of the value table before its inputs change.
+void sb_forget_value(SB_Func* func, SB_Node* node);
+
+uint64_t sb_constant_value(SB_Node* node);
+bool sb_should_compact(SB_Func* func);
+
+void sb_add_use(SB_Func* func, SB_Node* def, SB_Node* user, int32_t index);
+void sb_remove_use(SB_Func* func, SB_Node* user, int32_t index);
+
+typedef enum {
+  SB_NO_ALIAS,
+  SB_MAY_ALIAS,
+  SB_MUST_ALIAS
+} SB_AliasResult;
+
+// Alias queries between the address operands of loads and stores.
+SB_AliasResult sb_alias(SB_Func* func, SB_Node* a, SB_Node* b);
+
+// An alloca escapes once its address is used as anything but a load or
+// store address.
+bool sb_alloca_escapes(SB_Func* func, SB_Node* alloca);
+
+// Whether MEM_ESCAPE can observe a store to 'address'.
+bool sb_escape_may_read(SB_Func* func, SB_Node* address);
+
+typedef struct {
+  SB_Node* header;
+  int32_t parent; // index into SB_DomInfo.loops, -1 for an outermost loop
+  int32_t depth;  // 1 for an outermost loop
+} SB_Loop;
+
+// Dominator tree and loop nest over the CFG nodes reachable from START.
+// Arrays are indexed by node id and only meaningful for those nodes.
+typedef struct {
+  int32_t num_cfg;
+  SB_Node** rpo;      // reachable CFG nodes in reverse post order
+  int32_t* rpo_index; // -1 if unreachable
+
+  SB_Node** idom;     // NULL for START
+  int32_t* dom_depth; // 0 for START
+
+  int32_t num_loops;
+  SB_Loop* loops;
+  int32_t* loop;      // innermost loop containing the node, -1 if none
+} SB_DomInfo;
+
+SB_DomInfo sb_compute_dominators(Arena* arena, SB_Func* func);
+
+bool sb_dominates(SB_DomInfo* info, SB_Node* a, SB_Node* b);
+int32_t sb_loop_depth(SB_DomInfo* info, SB_Node* node);
+
+static inline SB_Node* sb_user(SB_Func* func, SB_Use* use) {
+  return func->nodes[use->user];
+}
\ No newline at end of file
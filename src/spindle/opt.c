@@ -47,92 +47,166 @@ static bool worklist_empty(Worklist* wl) {
   return vec_len(wl->packed) == 0;
 }
 
-static void remove_use(SB_Node* node, SB_Node* user, int index) {
-  for (SB_Use** pu = &node->uses; *pu;) {
-    SB_Use* u = *pu;
-
-    if (u->node == user && u->index == index) {
-      *pu = u->next;
-      return;
-    }
-    else {
-      pu = &u->next;
-    }
-  }
-
-  assert(false);
-}
-
-static void remove_node(Worklist* wl, SB_Node* first) {
+static void remove_node(SB_Func* func, Worklist* wl, SB_Node* first) {
   vec_clear(wl->stack);
   vec_put(wl->stack, first);
 
   while (vec_len(wl->stack)) {
     SB_Node* node = vec_pop(wl->stack);
-    assert(!node->uses);
+    assert(node->num_uses == 0);
 
     worklist_remove(wl, node);
 
     for (int32_t i = 0; i < node->num_ins; ++i) {
-      if (!node->ins[i]) {
+      SB_Node* input = sb_in(func, node, i);
+
+      if (!input) {
         continue;
       }
 
-      remove_use(node->ins[i], node, i);
+      sb_remove_use(func, node, i);
 
-      if (!node->ins[i]->uses) {
-        vec_put(wl->stack, node->ins[i]);
+      if (input->num_uses == 0) {
+        vec_put(wl->stack, input);
       }
     }
+
+    sb_kill_node(func, node);
   }
 }
 
-static void push_uses(Worklist* wl, SB_Node* node) {
-  for (SB_Use* use = node->uses; use; use = use->next) {
-    worklist_add(wl, use->node);
+static void push_uses(SB_Func* func, Worklist* wl, SB_Node* node) {
+  for (int32_t i = 0; i < node->num_uses; ++i) {
+    worklist_add(wl, sb_user(func, &node->uses[i]));
   }
 }
 
-static void replace_node(Worklist* wl, SB_Node* target, SB_Node* source) {
+static void replace_node(SB_Func* func, Worklist* wl, SB_Node* target, SB_Node* source) {
   assert(target != source);
 
-  push_uses(wl, target);
+  push_uses(func, wl, target);
+
+  for (int32_t i = 0; i < target->num_uses; ++i) {
+    SB_Use* use = &target->uses[i];
+    SB_Node* user = sb_user(func, use);
+
+    // Renumbered when the worklist gets to it.
+    sb_forget_value(func, user);
+
+    assert(user->ins[use->index] == target->id);
+    user->ins[use->index] = source->id;
+
+    sb_add_use(func, source, user, use->index);
+  }
+
+  target->num_uses = 0;
+
+  remove_node(func, wl, target);
+}
+
+// Points one input of 'node' somewhere else, freeing the old input if that
+// was its last use.
+static void replace_input(SB_Func* func, Worklist* wl, SB_Node* node, int32_t index, SB_Node* input) {
+  SB_Node* old = sb_in(func, node, index);
+  assert(old);
+
+  sb_forget_value(func, node);
+  worklist_add(wl, node);
+
+  sb_remove_use(func, node, index);
+  node->ins[index] = input ? input->id : 0;
 
-  for (SB_Use* use = target->uses; use; use = use->next) {
-    assert(use->node->ins[use->index] == target);
-    use->node->ins[use->index] = source;
+  if (input) {
+    sb_add_use(func, input, node, index);
   }
 
-  SB_Use** tail = &source->uses;
-  while (*tail) {
-    tail = &(*tail)->next;
+  if (old->num_uses == 0) {
+    remove_node(func, wl, old);
+  }
+  else {
+    worklist_add(wl, old);
+  }
+}
+
+// Drops input 'index' of a region or phi, shifting the later inputs down.
+static void remove_input(SB_Func* func, Worklist* wl, SB_Node* node, int32_t index) {
+  assert(node->kind == SB_NODE_REGION || node->kind == SB_NODE_PHI);
+
+  SB_Node* old = sb_in(func, node, index);
+
+  // Uses record their input index, so every shifted input is re-added.
+  for (int32_t i = index; i < node->num_ins; ++i) {
+    if (node->ins[i]) {
+      sb_remove_use(func, node, i);
+    }
   }
 
-  *tail = target->uses;
-  target->uses = NULL;
+  for (int32_t i = index; i + 1 < node->num_ins; ++i) {
+    node->ins[i] = node->ins[i + 1];
 
-  remove_node(wl, target);
+    if (node->ins[i]) {
+      sb_add_use(func, sb_in(func, node, i), node, i);
+    }
+  }
+
+  node->num_ins--;
+  worklist_add(wl, node);
+
+  if (!old) {
+    return;
+  }
+
+  if (old->num_uses == 0) {
+    remove_node(func, wl, old);
+  }
+  else {
+    worklist_add(wl, old);
+  }
+}
+
+// Removes control input 'index' of 'region' together with the matching input
+// of each of its phis.
+static void remove_region_input(SB_Func* func, Worklist* wl, SB_Node* region, int32_t index) {
+  assert(region->kind == SB_NODE_REGION);
+
+  for (int32_t i = 0; i < region->num_uses; ++i) {
+    SB_Node* user = sb_user(func, &region->uses[i]);
+
+    if (user->kind == SB_NODE_PHI) {
+      remove_input(func, wl, user, index + 1);
+    }
+  }
+
+  remove_input(func, wl, region, index);
 }
 
 typedef struct {
+  SB_Func* func;
   Worklist* wl;
 } IdealizeContext;
 
+// Bounds how many non-aliasing stores a load looks past per visit.
+#define LOAD_WALK_LIMIT 64
+
 typedef SB_Node*(*IdealizeFunc)(IdealizeContext*, SB_Node*);
 
 static SB_Node* idealize_phi(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
   SB_Node* same = NULL;
 
   for (int32_t i = 1; i < node->num_ins; ++i) {
-    if (!node->ins[i]) {
+    SB_Node* input = sb_in(func, node, i);
+
+    // A loop phi feeding itself adds no new value.
+    if (!input || input == node) {
       continue;
     }
 
     if (!same) {
-      same = node->ins[i];
+      same = input;
     }
 
-    if (same != node->ins[i]) {
+    if (same != input) {
       return node;
     }
   }
@@ -141,32 +215,77 @@ static SB_Node* idealize_phi(IdealizeContext* ctx, SB_Node* node) {
     return node;
   }
 
-  worklist_add(ctx->wl, node->ins[0]);
+  worklist_add(ctx->wl, sb_in(func, node, 0));
 
   return same;
 }
 
+static SB_Node* find_phi(SB_Func* func, SB_Node* region) {
+  for (int32_t i = 0; i < region->num_uses; ++i) {
+    SB_Node* user = sb_user(func, &region->uses[i]);
+
+    if (user->kind == SB_NODE_PHI) {
+      return user;
+    }
+  }
+
+  return NULL;
+}
+
 static SB_Node* idealize_region(IdealizeContext* ctx, SB_Node* node) {
-  (void)ctx;
+  SB_Func* func = ctx->func;
 
-  for (SB_Use* use = node->uses; use; use = use->next) {
-    if (use->node->kind == SB_NODE_PHI) {
-      return node;
+  for (int32_t i = node->num_ins - 1; i >= 0; --i) {
+    SB_Node* input = sb_in(func, node, i);
+
+    if (input && input->kind == SB_NODE_DEAD) {
+      remove_region_input(func, ctx->wl, node, i);
     }
   }
 
+  // With every input gone the region is unreachable. Its phis may carry
+  // memory, so they stay until nothing uses them.
+  if (node->num_ins == 0) {
+    return find_phi(func, node) ? node : sb_node_dead(func);
+  }
+
+  // A single entry makes each phi a copy of its one value. The exception is
+  // a loop header whose entry went away, its phis name themselves and the
+  // whole loop is unreachable.
+  if (node->num_ins == 1 && sb_in(func, node, 0)) {
+    for (int32_t i = 0; i < node->num_uses; ++i) {
+      SB_Node* user = sb_user(func, &node->uses[i]);
+
+      if (user->kind == SB_NODE_PHI && (!user->ins[1] || user->ins[1] == user->id)) {
+        return node;
+      }
+    }
+
+    for (SB_Node* phi = find_phi(func, node); phi; phi = find_phi(func, node)) {
+      replace_node(func, ctx->wl, phi, sb_in(func, phi, 1));
+    }
+
+    return sb_in(func, node, 0);
+  }
+
+  if (find_phi(func, node)) {
+    return node;
+  }
+
   SB_Node* same = NULL;
 
   for (int32_t i = 0; i < node->num_ins; ++i) {
-    if (!node->ins[i]) {
+    SB_Node* input = sb_in(func, node, i);
+
+    if (!input) {
       continue;
     }
 
     if (!same) {
-      same = node->ins[i];
+      same = input;
     }
 
-    if (same != node->ins[i]) {
+    if (same != input) {
       return node;
     }
   } 
@@ -175,13 +294,171 @@ static SB_Node* idealize_region(IdealizeContext* ctx, SB_Node* node) {
   return same;
 }
 
+// A constant predicate picks one side of the branch. The projections do the
+// folding, the branch only has to requeue them.
+static SB_Node* idealize_branch(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  if (sb_in(func, node, 0)->kind == SB_NODE_DEAD || sb_in(func, node, 1)->kind == SB_NODE_CONSTANT) {
+    push_uses(func, ctx->wl, node);
+  }
+
+  return node;
+}
+
+static SB_Node* idealize_branch_proj(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  SB_Node* branch = sb_in(func, node, 0);
+  SB_Node* ctrl = sb_in(func, branch, 0);
+  SB_Node* predicate = sb_in(func, branch, 1);
+
+  if (ctrl->kind == SB_NODE_DEAD) {
+    return ctrl;
+  }
+
+  if (predicate->kind != SB_NODE_CONSTANT) {
+    return node;
+  }
+
+  bool taken = (sb_constant_value(predicate) != 0) == (node->kind == SB_NODE_BRANCH_TRUE);
+  return taken ? ctrl : sb_node_dead(func);
+}
+
 static SB_Node* idealize_load(IdealizeContext* ctx, SB_Node* node) {
-  (void)ctx;
+  SB_Func* func = ctx->func;
+  SB_Node* first = sb_in(func, node, 1);
+  SB_Node* mem = first;
+
+  for (int steps = 0; mem->kind == SB_NODE_STORE && steps < LOAD_WALK_LIMIT; ++steps) {
+    SB_AliasResult alias = sb_alias(func, sb_in(func, mem, 2), sb_in(func, node, 2));
+
+    if (alias == SB_MUST_ALIAS) {
+      return sb_in(func, mem, 3);
+    }
+
+    if (alias == SB_MAY_ALIAS) {
+      break;
+    }
+
+    mem = sb_in(func, mem, 1);
+  }
+
+  // Hang the load off the oldest state it still depends on, so the stores
+  // it skipped stop keeping it in place and the next walk starts there.
+  if (mem != first) {
+    replace_input(func, ctx->wl, node, 1, mem);
+  }
+
+  return node;
+}
+
+static bool is_constant(SB_Node* node, uint64_t value) {
+  return node->kind == SB_NODE_CONSTANT && sb_constant_value(node) == value;
+}
+
+static bool both_constant(SB_Func* func, SB_Node* node) {
+  return sb_in(func, node, 0)->kind == SB_NODE_CONSTANT && sb_in(func, node, 1)->kind == SB_NODE_CONSTANT;
+}
+
+// Arithmetic wraps at 64 bits. Commutative nodes keep a constant operand on
+// the right, so the rules below only look there, and a constant pushed onto
+// an operation of the same kind is merged into it.
+
+static SB_Node* idealize_add(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  SB_Node* lhs = sb_in(func, node, 0);
+  SB_Node* rhs = sb_in(func, node, 1);
+
+  if (both_constant(func, node)) {
+    return sb_node_constant(func, sb_constant_value(lhs) + sb_constant_value(rhs));
+  }
+
+  if (lhs->kind == SB_NODE_CONSTANT) {
+    return sb_node_add(func, rhs, lhs);
+  }
+
+  if (is_constant(rhs, 0)) {
+    return lhs;
+  }
+
+  if (rhs->kind == SB_NODE_CONSTANT && lhs->kind == SB_NODE_ADD && sb_in(func, lhs, 1)->kind == SB_NODE_CONSTANT) {
+    SB_Node* sum = sb_node_constant(func, sb_constant_value(sb_in(func, lhs, 1)) + sb_constant_value(rhs));
+    return sb_node_add(func, sb_in(func, lhs, 0), sum);
+  }
 
-  SB_Node* mem = node->ins[1];
+  return node;
+}
+
+static SB_Node* idealize_sub(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  SB_Node* lhs = sb_in(func, node, 0);
+  SB_Node* rhs = sb_in(func, node, 1);
+
+  if (both_constant(func, node)) {
+    return sb_node_constant(func, sb_constant_value(lhs) - sb_constant_value(rhs));
+  }
+
+  if (lhs == rhs) {
+    return sb_node_constant(func, 0);
+  }
+
+  if (is_constant(rhs, 0)) {
+    return lhs;
+  }
+
+  // x - c becomes x + -c, so it can merge with neighbouring adds.
+  if (rhs->kind == SB_NODE_CONSTANT) {
+    return sb_node_add(func, lhs, sb_node_constant(func, 0 - sb_constant_value(rhs)));
+  }
+
+  return node;
+}
 
-  if (mem->kind == SB_NODE_STORE && mem->ins[2] == node->ins[2]) {
-    return mem->ins[3];
+static SB_Node* idealize_mul(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  SB_Node* lhs = sb_in(func, node, 0);
+  SB_Node* rhs = sb_in(func, node, 1);
+
+  if (both_constant(func, node)) {
+    return sb_node_constant(func, sb_constant_value(lhs) * sb_constant_value(rhs));
+  }
+
+  if (lhs->kind == SB_NODE_CONSTANT) {
+    return sb_node_mul(func, rhs, lhs);
+  }
+
+  if (is_constant(rhs, 0)) {
+    return rhs;
+  }
+
+  if (is_constant(rhs, 1)) {
+    return lhs;
+  }
+
+  if (rhs->kind == SB_NODE_CONSTANT && lhs->kind == SB_NODE_MUL && sb_in(func, lhs, 1)->kind == SB_NODE_CONSTANT) {
+    SB_Node* product = sb_node_constant(func, sb_constant_value(sb_in(func, lhs, 1)) * sb_constant_value(rhs));
+    return sb_node_mul(func, sb_in(func, lhs, 0), product);
+  }
+
+  return node;
+}
+
+// Division by zero is left for run time. INT64_MIN / -1 wraps back to
+// INT64_MIN instead of trapping.
+static SB_Node* idealize_sdiv(IdealizeContext* ctx, SB_Node* node) {
+  SB_Func* func = ctx->func;
+  SB_Node* lhs = sb_in(func, node, 0);
+  SB_Node* rhs = sb_in(func, node, 1);
+
+  if (both_constant(func, node) && !is_constant(rhs, 0)) {
+    int64_t a = (int64_t)sb_constant_value(lhs);
+    int64_t b = (int64_t)sb_constant_value(rhs);
+
+    uint64_t quotient = (a == INT64_MIN && b == -1) ? (uint64_t)a : (uint64_t)(a / b);
+    return sb_node_constant(func, quotient);
+  }
+
+  if (is_constant(rhs, 1)) {
+    return lhs;
   }
 
   return node;
@@ -190,11 +467,19 @@ static SB_Node* idealize_load(IdealizeContext* ctx, SB_Node* node) {
 static IdealizeFunc idealize_table[NUM_SB_NODE_KINDS] = {
   [SB_NODE_PHI] = idealize_phi,
   [SB_NODE_REGION] = idealize_region,
+  [SB_NODE_BRANCH] = idealize_branch,
+  [SB_NODE_BRANCH_TRUE] = idealize_branch_proj,
+  [SB_NODE_BRANCH_FALSE] = idealize_branch_proj,
   [SB_NODE_LOAD] = idealize_load,
+  [SB_NODE_ADD] = idealize_add,
+  [SB_NODE_SUB] = idealize_sub,
+  [SB_NODE_MUL] = idealize_mul,
+  [SB_NODE_SDIV] = idealize_sdiv,
 };
 
-static void peeps(Worklist* wl) {
+static void peeps(SB_Func* func, Worklist* wl) {
   IdealizeContext ideal_ctx = {
+    .func = func,
     .wl = wl
   };
 
@@ -204,108 +489,787 @@ static void peeps(Worklist* wl) {
     IdealizeFunc idealize = idealize_table[node->kind];
 
     if (idealize) {
+      int32_t id = node->id;
       SB_Node* ideal = idealize(&ideal_ctx, node);
 
+      // Collapsing a region replaces its phis, which can free the region.
+      if (func->nodes[id] != node) {
+        continue;
+      }
+
       if (ideal != node) {
-        replace_node(wl, node, ideal);
+        // A freshly built replacement may simplify further.
+        worklist_add(wl, ideal);
+        replace_node(func, wl, node, ideal);
+        continue;
+      }
+    }
+
+    SB_Node* existing = sb_value_number(func, node);
+
+    if (existing != node) {
+      replace_node(func, wl, node, existing);
+    }
+  }
+}
+
+// remove_node only sees nodes whose last use went away. Phi/add cycles and
+// phi webs that no longer reach END keep each other alive, so sweep
+// everything the walk from END does not mark.
+static void remove_dead_cycles(SB_Func* func, Worklist* wl) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  GraphWalk walk = post_order_walk_ins(scratch.arena, func);
+
+  if ((int32_t)walk.count == func->num_live) {
+    scratch_release(&scratch);
+    return;
+  }
+
+  // Detach from live inputs first, the use arrays still refer to dead users by id.
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (!node || bitset_get(walk.visited, id)) {
+      continue;
+    }
+
+    for (int32_t i = 0; i < node->num_ins; ++i) {
+      SB_Node* input = sb_in(func, node, i);
+
+      if (input && bitset_get(walk.visited, input->id)) {
+        sb_remove_use(func, node, i);
+        worklist_add(wl, input);
       }
     }
   }
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (node && !bitset_get(walk.visited, id)) {
+      worklist_remove(wl, node);
+      sb_kill_node(func, node);
+    }
+  }
+
+  scratch_release(&scratch);
 }
 
+// Sparse conditional constant propagation. Data nodes climb the lattice
+// TOP -> constant -> BOTTOM, CFG nodes start unreached (TOP) and become
+// reached (BOTTOM). Phis only merge inputs along reached region edges and a
+// branch only reaches the projections its predicate allows, so constants
+// that the local peepholes can not prove fall out of loops and dead arms.
+
 typedef enum {
-  DSE_NO_READS,
-  DSE_READS
-} DSE_State;
+  SCCP_TOP,
+  SCCP_CONSTANT,
+  SCCP_BOTTOM
+} SccpLevel;
 
-static void dead_store_elim(SB_Func* func, Worklist* wl) {
+typedef struct {
+  SccpLevel level;
+  uint64_t value;
+} SccpCell;
+
+// A branch to fold. Its predicate's cell is taken before the predicate is
+// replaced by a constant, whose id lies past the end of 'cells'.
+typedef struct {
+  SB_Node* branch;
+  SccpCell predicate;
+} SccpBranch;
+
+static SccpCell sccp_top() {
+  return (SccpCell) { .level = SCCP_TOP };
+}
+
+static SccpCell sccp_bottom() {
+  return (SccpCell) { .level = SCCP_BOTTOM };
+}
+
+static SccpCell sccp_constant(uint64_t value) {
+  return (SccpCell) { .level = SCCP_CONSTANT, .value = value };
+}
+
+static SccpCell sccp_meet(SccpCell a, SccpCell b) {
+  if (a.level == SCCP_TOP) {
+    return b;
+  }
+
+  if (b.level == SCCP_TOP) {
+    return a;
+  }
+
+  if (a.level == SCCP_CONSTANT && b.level == SCCP_CONSTANT && a.value == b.value) {
+    return a;
+  }
+
+  return sccp_bottom();
+}
+
+static bool sccp_reached(SccpCell* cells, SB_Node* node) {
+  return node && cells[node->id].level != SCCP_TOP;
+}
+
+static SccpCell sccp_arith(SB_Node* node, SccpCell lhs, SccpCell rhs) {
+  // Zero times anything is zero, even an unknown.
+  if (node->kind == SB_NODE_MUL) {
+    if ((lhs.level == SCCP_CONSTANT && lhs.value == 0) || (rhs.level == SCCP_CONSTANT && rhs.value == 0)) {
+      return sccp_constant(0);
+    }
+  }
+
+  if (lhs.level == SCCP_TOP || rhs.level == SCCP_TOP) {
+    return sccp_top();
+  }
+
+  if (lhs.level == SCCP_BOTTOM || rhs.level == SCCP_BOTTOM) {
+    return sccp_bottom();
+  }
+
+  uint64_t a = lhs.value;
+  uint64_t b = rhs.value;
+
+  switch (node->kind) {
+    default:
+      assert(false);
+      return sccp_bottom();
+
+    case SB_NODE_ADD:
+      return sccp_constant(a + b);
+    case SB_NODE_SUB:
+      return sccp_constant(a - b);
+    case SB_NODE_MUL:
+      return sccp_constant(a * b);
+
+    case SB_NODE_SDIV:
+      if (b == 0) {
+        return sccp_bottom();
+      }
+
+      if ((int64_t)a == INT64_MIN && (int64_t)b == -1) {
+        return sccp_constant(a);
+      }
+
+      return sccp_constant((uint64_t)((int64_t)a / (int64_t)b));
+  }
+}
+
+static SccpCell sccp_eval(SB_Func* func, SccpCell* cells, SB_Node* node) {
+  switch (node->kind) {
+    default:
+      return sccp_bottom();
+
+    case SB_NODE_START:
+      return sccp_bottom();
+
+    case SB_NODE_DEAD:
+      return sccp_top();
+
+    case SB_NODE_CONSTANT:
+      return sccp_constant(sb_constant_value(node));
+
+    case SB_NODE_START_CTRL:
+    case SB_NODE_START_MEM:
+    case SB_NODE_BRANCH:
+    case SB_NODE_END:
+      return sccp_reached(cells, sb_in(func, node, 0)) ? sccp_bottom() : sccp_top();
+
+    case SB_NODE_REGION:
+      for (int32_t i = 0; i < node->num_ins; ++i) {
+        if (sccp_reached(cells, sb_in(func, node, i))) {
+          return sccp_bottom();
+        }
+      }
+
+      return sccp_top();
+
+    case SB_NODE_BRANCH_TRUE:
+    case SB_NODE_BRANCH_FALSE: {
+      SB_Node* branch = sb_in(func, node, 0);
+
+      if (!sccp_reached(cells, branch)) {
+        return sccp_top();
+      }
+
+      SccpCell predicate = cells[branch->ins[1]];
+
+      if (predicate.level == SCCP_TOP) {
+        return sccp_top();
+      }
+
+      if (predicate.level == SCCP_CONSTANT && (predicate.value != 0) != (node->kind == SB_NODE_BRANCH_TRUE)) {
+        return sccp_top();
+      }
+
+      return sccp_bottom();
+    }
+
+    case SB_NODE_PHI: {
+      SB_Node* region = sb_in(func, node, 0);
+      SccpCell cell = sccp_top();
+
+      for (int32_t i = 1; i < node->num_ins; ++i) {
+        if (node->ins[i] && sccp_reached(cells, sb_in(func, region, i - 1))) {
+          cell = sccp_meet(cell, cells[node->ins[i]]);
+        }
+      }
+
+      return cell;
+    }
+
+    case SB_NODE_ADD:
+    case SB_NODE_SUB:
+    case SB_NODE_MUL:
+    case SB_NODE_SDIV:
+      return sccp_arith(node, cells[node->ins[0]], cells[node->ins[1]]);
+  }
+}
+
+static void sccp_push_users(SB_Func* func, Worklist* wl, SB_Node* node) {
+  for (int32_t i = 0; i < node->num_uses; ++i) {
+    SB_Node* user = sb_user(func, &node->uses[i]);
+    worklist_add(wl, user);
+
+    // Projections read the branch predicate and phis read which region
+    // inputs are reached, neither is an input of their own.
+    if (user->kind == SB_NODE_BRANCH || user->kind == SB_NODE_REGION) {
+      push_uses(func, wl, user);
+    }
+  }
+}
+
+static void sccp(SB_Func* func, Worklist* wl) {
   Scratch scratch = scratch_get(0, NULL);
 
-  DSE_State* states = arena_array(scratch.arena, DSE_State, func->next_id);
+  SccpCell* cells = arena_array(scratch.arena, SccpCell, func->next_id);
 
-  vec_clear(wl->stack);
+  Worklist sccp_wl = {0};
 
-  GraphWalk walk = post_order_walk_ins(scratch.arena, func);
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    if (func->nodes[id]) {
+      worklist_add(&sccp_wl, func->nodes[id]);
+    }
+  }
+
+  while (!worklist_empty(&sccp_wl)) {
+    SB_Node* node = worklist_pop(&sccp_wl);
+
+    SccpCell old = cells[node->id];
+    SccpCell cell = sccp_eval(func, cells, node);
+
+    // Cells only ever move down the lattice.
+    cell = sccp_meet(old, cell);
+
+    if (cell.level != old.level || cell.value != old.value) {
+      cells[node->id] = cell;
+      sccp_push_users(func, &sccp_wl, node);
+    }
+  }
+
+  vec_free(sccp_wl.packed);
+  vec_free(sccp_wl.sparse);
+  vec_free(sccp_wl.stack);
+
+  // Rewriting creates and frees nodes, so collect what to change first.
+  int32_t num_ids = func->next_id;
+
+  Vec(SB_Node*) constants = NULL;
+  vec_in_arena(constants, scratch.arena);
+
+  Vec(SccpBranch) branches = NULL;
+  vec_in_arena(branches, scratch.arena);
+
+  Vec(SB_Node*) regions = NULL;
+  vec_in_arena(regions, scratch.arena);
+
+  for (int32_t id = 1; id < num_ids; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (!node) {
+      continue;
+    }
+
+    switch (node->kind) {
+      default:
+        break;
+
+      case SB_NODE_PHI:
+      case SB_NODE_ADD:
+      case SB_NODE_SUB:
+      case SB_NODE_MUL:
+      case SB_NODE_SDIV:
+        if (cells[id].level == SCCP_CONSTANT) {
+          vec_put(constants, node);
+        }
+        break;
+
+      case SB_NODE_BRANCH:
+        if (sccp_reached(cells, node) && cells[node->ins[1]].level == SCCP_CONSTANT) {
+          vec_put(branches, ((SccpBranch) { .branch = node, .predicate = cells[node->ins[1]] }));
+        }
+        break;
+
+      case SB_NODE_REGION:
+        if (sccp_reached(cells, node)) {
+          vec_put(regions, node);
+        }
+        break;
+    }
+  }
+
+  for (int i = 0; i < vec_len(constants); ++i) {
+    SB_Node* node = constants[i];
+
+    if (func->nodes[node->id] == node) {
+      replace_node(func, wl, node, sb_node_constant(func, cells[node->id].value));
+    }
+  }
+
+  // Unreached edges into live regions go first, after that nothing live
+  // depends on the never-taken side of a branch.
+  for (int i = 0; i < vec_len(regions); ++i) {
+    SB_Node* region = regions[i];
+
+    for (int32_t j = region->num_ins - 1; j >= 0; --j) {
+      SB_Node* input = sb_in(func, region, j);
+
+      if (input && input->id < num_ids && !sccp_reached(cells, input)) {
+        remove_region_input(func, wl, region, j);
+      }
+    }
+  }
+
+  SB_Node* dead = NULL;
+
+  for (int i = 0; i < vec_len(branches); ++i) {
+    SB_Node* branch = branches[i].branch;
+    SccpCell predicate = branches[i].predicate;
+
+    if (func->nodes[branch->id] != branch) {
+      continue;
+    }
+
+    // Removing region inputs above may already have freed the projection
+    // that is never taken, so go by the predicate rather than by the uses.
+    SB_NodeKind taken_kind = predicate.value ? SB_NODE_BRANCH_TRUE : SB_NODE_BRANCH_FALSE;
 
-  size_t num_stores = 0;
-  SB_Node** stores = arena_array(scratch.arena, SB_Node*, walk.count);
+    SB_Node* taken = NULL;
+    SB_Node* not_taken = NULL;
 
-  for (size_t i = 0; i < walk.count; ++i) {
-    SB_Node* node = walk.nodes[i];
+    for (int32_t j = 0; j < branch->num_uses; ++j) {
+      SB_Node* proj = sb_user(func, &branch->uses[j]);
 
-    if (node->flags & SB_FLAG_READS_MEM) {
-      assert(node->flags & SB_FLAG_HAS_MEM_DEP);
-      vec_put(wl->stack, node);
+      if (proj->kind == taken_kind) {
+        taken = proj;
+      }
+      else {
+        not_taken = proj;
+      }
+    }
+
+    // The branch dies with its last projection.
+    SB_Node* ctrl = sb_in(func, branch, 0);
+
+    if (not_taken) {
+      if (!dead) {
+        dead = sb_node_dead(func);
+      }
+
+      replace_node(func, wl, not_taken, dead);
     }
 
-    if (node->kind == SB_NODE_STORE) {
-      stores[num_stores++] = node;
+    if (taken) {
+      replace_node(func, wl, taken, ctrl);
     }
   }
 
+  if (dead) {
+    worklist_add(wl, dead);
+  }
+
+  scratch_release(&scratch);
+}
+
+// Marks every store that a read of 'address' can observe from any of
+// 'readers', walking back until a store that must alias it overwrites the
+// location. A NULL address stands for MEM_ESCAPE, which reads everything
+// that escapes.
+static void dse_mark_reads(SB_Func* func, Worklist* wl, Vec(SB_Node*) readers, SB_Node* address, uint64_t* visited, uint64_t* live) {
+  memset(visited, 0, bitset_num_u64(func->next_id) * sizeof(uint64_t));
+
+  vec_clear(wl->stack);
+
+  for (int i = 0; i < vec_len(readers); ++i) {
+    vec_put(wl->stack, sb_in(func, readers[i], 1));
+  }
+
   while (vec_len(wl->stack)) {
     SB_Node* node = vec_pop(wl->stack);
 
-    if (states[node->id] == DSE_READS) {
+    if (bitset_get(visited, node->id)) {
       continue;
     }
 
-    states[node->id] = DSE_READS;
+    bitset_set(visited, node->id);
 
     if (node->kind == SB_NODE_PHI) {
       for (int32_t i = 1; i < node->num_ins; ++i) {
-        if (!node->ins[i]) {
-          continue;
+        if (node->ins[i]) {
+          vec_put(wl->stack, sb_in(func, node, i));
         }
+      }
+    }
+    else if (node->kind == SB_NODE_STORE) {
+      SB_AliasResult alias = address ? sb_alias(func, sb_in(func, node, 2), address) : (sb_escape_may_read(func, sb_in(func, node, 2)) ? SB_MAY_ALIAS : SB_NO_ALIAS);
+
+      if (alias != SB_NO_ALIAS) {
+        bitset_set(live, node->id);
+      }
 
-        vec_put(wl->stack, node->ins[i]);
+      if (alias != SB_MUST_ALIAS) {
+        vec_put(wl->stack, sb_in(func, node, 1));
       }
     }
-    else if (node->flags & SB_FLAG_HAS_MEM_DEP) {
-      vec_put(wl->stack, node->ins[1]);
+  }
+}
+
+// A store is live if some reader can see it. Readers are grouped by address,
+// so the memory graph is walked once per distinct address read rather than
+// once per reader.
+static void dead_store_elim(SB_Func* func, Worklist* wl) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  Vec(SB_Node*) stores = NULL;
+  vec_in_arena(stores, scratch.arena);
+
+  Vec(SB_Node*) escapes = NULL;
+  vec_in_arena(escapes, scratch.arena);
+
+  // Loads sorted into buckets per address, 'first_load' heads each bucket.
+  int32_t* first_load = arena_array(scratch.arena, int32_t, func->next_id);
+  int32_t* next_load = arena_array(scratch.arena, int32_t, func->next_id);
+
+  Vec(SB_Node*) addresses = NULL;
+  vec_in_arena(addresses, scratch.arena);
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (!node) {
+      continue;
+    }
+
+    switch (node->kind) {
+      default:
+        assert(!(node->flags & SB_FLAG_READS_MEM));
+        break;
+
+      case SB_NODE_STORE:
+        vec_put(stores, node);
+        break;
+
+      case SB_NODE_MEM_ESCAPE:
+        vec_put(escapes, node);
+        break;
+
+      case SB_NODE_LOAD: {
+        SB_Node* address = sb_in(func, node, 2);
+
+        if (!first_load[address->id]) {
+          vec_put(addresses, address);
+        }
+
+        next_load[id] = first_load[address->id];
+        first_load[address->id] = id;
+      } break;
     }
   }
 
-  for (size_t i = 0; i < num_stores; ++i) {
+  if (vec_len(stores) == 0) {
+    scratch_release(&scratch);
+    return;
+  }
+
+  uint64_t* visited = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id));
+  uint64_t* live = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id));
+
+  dse_mark_reads(func, wl, escapes, NULL, visited, live);
+
+  Vec(SB_Node*) readers = NULL;
+  vec_in_arena(readers, scratch.arena);
+
+  for (int i = 0; i < vec_len(addresses); ++i) {
+    SB_Node* address = addresses[i];
+
+    vec_clear(readers);
+
+    for (int32_t id = first_load[address->id]; id; id = next_load[id]) {
+      vec_put(readers, func->nodes[id]);
+    }
+
+    dse_mark_reads(func, wl, readers, address, visited, live);
+  }
+
+  for (int i = 0; i < vec_len(stores); ++i) {
     SB_Node* store = stores[i];
 
-    if (states[store->id] == DSE_READS) {
+    // Removing one store can free an unused one below it.
+    if (func->nodes[store->id] != store) {
       continue;
     }
 
-    replace_node(wl, store, store->ins[1]);
+    if (!bitset_get(live, store->id)) {
+      replace_node(func, wl, store, sb_in(func, store, 1));
+    }
   }
 
   scratch_release(&scratch);
 }
 
-void sb_opt(SB_Context* ctx, SB_Func* func) {
-  (void)ctx;
+typedef struct {
+  SB_Func* func;
+  Worklist* wl;
+  Arena* arena;
+
+  SB_Node* alloca;
+  SB_Node* undef;
+
+  // Indexed by memory node id, valid where stamp matches the current alloca.
+  int32_t* stamps;
+  SB_Node** values;
+  int32_t stamp;
+
+  Vec(SB_Node*) path;
+  Vec(SB_Node*) pending; // memory phis whose value phi still needs inputs
+} Promotion;
+
+static bool promo_lookup(Promotion* p, SB_Node* mem, SB_Node** value) {
+  if (p->stamps[mem->id] != p->stamp) {
+    return false;
+  }
+
+  *value = p->values[mem->id];
+  return true;
+}
+
+static void promo_record(Promotion* p, SB_Node* mem, SB_Node* value) {
+  p->stamps[mem->id] = p->stamp;
+  p->values[mem->id] = value;
+}
+
+// Value of the alloca in memory state 'mem'. Walks back over stores to other
+// addresses. A memory phi gets a value phi on the same region, its inputs are
+// filled in later from 'pending' so loops do not recurse.
+static SB_Node* promo_value(Promotion* p, SB_Node* mem) {
+  SB_Func* func = p->func;
+  vec_clear(p->path);
+
+  SB_Node* value = NULL;
+
+  while (!promo_lookup(p, mem, &value)) {
+    if (mem->kind == SB_NODE_STORE && sb_in(func, mem, 2) != p->alloca) {
+      vec_put(p->path, mem);
+      mem = sb_in(func, mem, 1);
+      continue;
+    }
+
+    switch (mem->kind) {
+      default:
+        assert(false && "unexpected memory node");
+        break;
+
+      case SB_NODE_STORE:
+        value = sb_in(func, mem, 3);
+        break;
+
+      case SB_NODE_START_MEM:
+        value = p->undef;
+        break;
+
+      case SB_NODE_PHI:
+        value = sb_node_phi(p->func);
+        vec_put(p->pending, mem);
+        worklist_add(p->wl, value);
+        break;
+    }
+
+    promo_record(p, mem, value);
+    break;
+  }
+
+  for (int i = 0; i < vec_len(p->path); ++i) {
+    promo_record(p, p->path[i], value);
+  }
+
+  return value;
+}
+
+static void promote_alloca(Promotion* p, SB_Node* alloca) {
+  SB_Func* func = p->func;
+
+  p->alloca = alloca;
+  p->stamp++;
+
+  Scratch scratch = scratch_get(1, &p->arena);
+
+  int32_t num_uses = alloca->num_uses;
+  int32_t* users = arena_array(scratch.arena, int32_t, num_uses);
+
+  for (int32_t i = 0; i < num_uses; ++i) {
+    users[i] = alloca->uses[i].user;
+  }
+
+  // Resolve every load before touching the graph, the walk needs the stores.
+  // Loads are not memory nodes, so their slots in the table are free.
+  for (int32_t i = 0; i < num_uses; ++i) {
+    SB_Node* load = func->nodes[users[i]];
+
+    if (load->kind == SB_NODE_LOAD) {
+      promo_record(p, load, promo_value(p, sb_in(func, load, 1)));
+    }
+  }
+
+  while (vec_len(p->pending)) {
+    SB_Node* mem_phi = vec_pop(p->pending);
+
+    SB_Node* phi = NULL;
+    promo_lookup(p, mem_phi, &phi);
+
+    int32_t num_ins = mem_phi->num_ins - 1;
+    SB_Node** ins = arena_array(scratch.arena, SB_Node*, num_ins);
 
+    for (int32_t i = 0; i < num_ins; ++i) {
+      SB_Node* mem = sb_in(func, mem_phi, i + 1);
+      ins[i] = mem ? promo_value(p, mem) : p->undef;
+    }
+
+    sb_set_phi_ins(func, phi, sb_in(func, mem_phi, 0), num_ins, ins);
+  }
+
+  // A stored value can itself be a load of the alloca, follow those to the
+  // end before any load goes away.
+  SB_Node** loaded = arena_array(scratch.arena, SB_Node*, num_uses);
+
+  for (int32_t i = 0; i < num_uses; ++i) {
+    SB_Node* load = func->nodes[users[i]];
+
+    if (load->kind != SB_NODE_LOAD) {
+      continue;
+    }
+
+    SB_Node* value = load;
+
+    while (value->kind == SB_NODE_LOAD && sb_in(func, value, 2) == alloca) {
+      promo_lookup(p, value, &value);
+    }
+
+    loaded[i] = value;
+  }
+
+  // Replacing one user can free another whose last use it was, so users are
+  // looked up by id again.
+  for (int32_t i = 0; i < num_uses; ++i) {
+    SB_Node* load = func->nodes[users[i]];
+
+    if (load && load->kind == SB_NODE_LOAD) {
+      replace_node(func, p->wl, load, loaded[i]);
+    }
+  }
+
+  // Dropping the last store also drops the alloca.
+  for (int32_t i = 0; i < num_uses; ++i) {
+    SB_Node* store = func->nodes[users[i]];
+
+    if (store && store->kind == SB_NODE_STORE) {
+      replace_node(func, p->wl, store, sb_in(func, store, 1));
+    }
+  }
+
+  scratch_release(&scratch);
+}
+
+// Loads of an alloca that never escapes become the values stored to it,
+// with phis where memory merges, and its stores are deleted.
+static void promote_allocas(SB_Func* func, Worklist* wl) {
   Scratch scratch = scratch_get(0, NULL);
 
-  Worklist wl = {0};
+  Vec(SB_Node*) allocas = NULL;
+  vec_in_arena(allocas, scratch.arena);
 
-  GraphWalk walk = post_order_walk_ins(scratch.arena, func);
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
 
-  for (size_t i = 0; i < walk.count; ++i) {
-    worklist_add(&wl, walk.nodes[i]);
+    if (node && node->kind == SB_NODE_ALLOCA && node->num_uses && !sb_alloca_escapes(func, node)) {
+      vec_put(allocas, node);
+    }
+  }
+
+  if (vec_len(allocas) == 0) {
+    scratch_release(&scratch);
+    return;
+  }
+
+  SB_Node* undef = sb_node_null(func);
+  worklist_add(wl, undef);
+
+  // Only pre-existing nodes are looked up, new phis are values.
+  Promotion p = {
+    .func = func,
+    .wl = wl,
+    .arena = scratch.arena,
+    .undef = undef,
+    .stamps = arena_array(scratch.arena, int32_t, func->next_id),
+    .values = arena_array(scratch.arena, SB_Node*, func->next_id),
+  };
+
+  vec_in_arena(p.path, scratch.arena);
+  vec_in_arena(p.pending, scratch.arena);
+
+  for (int i = 0; i < vec_len(allocas); ++i) {
+    promote_alloca(&p, allocas[i]);
   }
 
+  scratch_release(&scratch);
+}
+
+void sb_opt(SB_Context* ctx, SB_Func* func) {
+  (void)ctx;
+
+  Worklist wl = {0};
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    if (func->nodes[id]) {
+      worklist_add(&wl, func->nodes[id]);
+    }
+  }
+
+  promote_allocas(func, &wl);
+
   while (true) {
+    sccp(func, &wl);
+    remove_dead_cycles(func, &wl);
     dead_store_elim(func, &wl);
 
     if (!worklist_empty(&wl)) {
-      peeps(&wl);
+      peeps(func, &wl);
     }
     else {
       break;
     }
+
+    // The worklist is empty here, so no node pointers are held across the move.
+    if (sb_should_compact(func)) {
+      sb_compact_func(func);
+    }
+  }
+
+  if (sb_should_compact(func)) {
+    sb_compact_func(func);
   }
 
   vec_free(wl.packed);
   vec_free(wl.sparse);
   vec_free(wl.stack);
-
-  scratch_release(&scratch);
 }
\ No newline at end of file
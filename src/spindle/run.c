@@ -0,0 +1,257 @@
+#include <stdio.h>
+
+#include "spindle.h"
+#include "utility.h"
+#include "internal.h"
+
+// Block entries before a run gives up, the function does not terminate.
+#define RUN_MAX_BLOCKS ((int64_t)1 << 24)
+
+// Values live in a table by node id. An alloca's value is its own id, which
+// also indexes the memory it stands for. Memory states carry no value.
+
+typedef struct {
+  SB_Func* func;
+
+  uint64_t* values;
+  uint64_t* defined; // set once a node has executed
+  uint64_t* memory;
+
+  int64_t num_blocks_run;
+} Runner;
+
+static bool run_error(SB_Node* node, const char* message) {
+  fprintf(stderr, "run: n%d (%s): %s\n", node->id, sb_node_kind_label[node->kind], message);
+  return false;
+}
+
+static bool read_input(Runner* r, SB_Node* node, int32_t index, uint64_t* value) {
+  SB_Node* input = sb_in(r->func, node, index);
+
+  if (!input || !bitset_get(r->defined, input->id)) {
+    return run_error(node, "input used before its definition ran");
+  }
+
+  *value = r->values[input->id];
+  return true;
+}
+
+static bool read_address(Runner* r, SB_Node* node, uint64_t* address) {
+  if (!read_input(r, node, 2, address)) {
+    return false;
+  }
+
+  SB_Node* alloca = *address < (uint64_t)r->func->next_id ? r->func->nodes[*address] : NULL;
+
+  if (!alloca || alloca->kind != SB_NODE_ALLOCA) {
+    return run_error(node, "address is not an alloca");
+  }
+
+  return true;
+}
+
+static bool execute(Runner* r, SB_Node* node) {
+  uint64_t value = 0;
+  uint64_t lhs, rhs, address;
+
+  switch (node->kind) {
+    default:
+      return run_error(node, "can not be executed");
+
+    case SB_NODE_START_MEM:
+    case SB_NODE_NULL:
+      break;
+
+    case SB_NODE_MEM_ESCAPE:
+      if (!read_input(r, node, 1, &value)) {
+        return false;
+      }
+      break;
+
+    case SB_NODE_CONSTANT:
+      value = sb_constant_value(node);
+      break;
+
+    case SB_NODE_ALLOCA:
+      value = (uint64_t)node->id;
+      break;
+
+    case SB_NODE_LOAD:
+      if (!read_input(r, node, 1, &value) || !read_address(r, node, &address)) {
+        return false;
+      }
+
+      value = r->memory[address];
+      break;
+
+    case SB_NODE_STORE:
+      if (!read_input(r, node, 1, &value) || !read_address(r, node, &address) || !read_input(r, node, 3, &rhs)) {
+        return false;
+      }
+
+      r->memory[address] = rhs;
+      break;
+
+    case SB_NODE_ADD:
+    case SB_NODE_SUB:
+    case SB_NODE_MUL:
+    case SB_NODE_SDIV:
+      if (!read_input(r, node, 0, &lhs) || !read_input(r, node, 1, &rhs)) {
+        return false;
+      }
+
+      switch (node->kind) {
+        default:
+          break;
+        case SB_NODE_ADD:
+          value = lhs + rhs;
+          break;
+        case SB_NODE_SUB:
+          value = lhs - rhs;
+          break;
+        case SB_NODE_MUL:
+          value = lhs * rhs;
+          break;
+        case SB_NODE_SDIV:
+          if (rhs == 0) {
+            return run_error(node, "division by zero");
+          }
+
+          // Wraps like the optimizer's folding does.
+          value = ((int64_t)lhs == INT64_MIN && (int64_t)rhs == -1) ? lhs : (uint64_t)((int64_t)lhs / (int64_t)rhs);
+          break;
+      }
+      break;
+  }
+
+  r->values[node->id] = value;
+  bitset_set(r->defined, node->id);
+
+  return true;
+}
+
+// Phis of the block read their inputs along edge 'index' of its region, all
+// before any of them is written.
+static bool enter_block(Runner* r, SB_Block* block, int32_t index) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  uint64_t* incoming = arena_array(scratch.arena, uint64_t, block->num_nodes);
+  bool ok = true;
+
+  for (int32_t i = 0; ok && i < block->num_nodes && block->nodes[i]->kind == SB_NODE_PHI; ++i) {
+    ok = read_input(r, block->nodes[i], index + 1, &incoming[i]);
+  }
+
+  for (int32_t i = 0; ok && i < block->num_nodes && block->nodes[i]->kind == SB_NODE_PHI; ++i) {
+    r->values[block->nodes[i]->id] = incoming[i];
+    bitset_set(r->defined, block->nodes[i]->id);
+  }
+
+  scratch_release(&scratch);
+
+  return ok;
+}
+
+// The projection of 'branch' that control leaves through.
+static SB_Node* taken_proj(SB_Func* func, SB_Node* branch, bool predicate) {
+  SB_NodeKind kind = predicate ? SB_NODE_BRANCH_TRUE : SB_NODE_BRANCH_FALSE;
+
+  for (int32_t i = 0; i < branch->num_uses; ++i) {
+    SB_Node* user = sb_user(func, &branch->uses[i]);
+
+    if (user->kind == kind) {
+      return user;
+    }
+  }
+
+  return NULL;
+}
+
+bool sb_run_schedule(SB_Func* func, SB_Schedule* schedule, uint64_t* result) {
+  Scratch scratch = scratch_get(0, NULL);
+
+  Runner r = {
+    .func = func,
+    .values = arena_array(scratch.arena, uint64_t, func->next_id),
+    .defined = arena_array(scratch.arena, uint64_t, bitset_num_u64(func->next_id)),
+    .memory = arena_array(scratch.arena, uint64_t, func->next_id)
+  };
+
+  bool ok = true;
+  int32_t b = 0;
+
+  while (ok) {
+    SB_Block* block = &schedule->blocks[b];
+
+    for (int32_t i = 0; ok && i < block->num_nodes; ++i) {
+      SB_Node* node = block->nodes[i];
+
+      if (node->kind == SB_NODE_PHI || (node->flags & SB_FLAG_IS_CFG)) {
+        continue;
+      }
+
+      ok = execute(&r, node);
+    }
+
+    if (!ok) {
+      break;
+    }
+
+    if (++r.num_blocks_run > RUN_MAX_BLOCKS) {
+      ok = run_error(block->head, "gave up, the function does not seem to terminate");
+      break;
+    }
+
+    SB_Node* tail = block->tail;
+
+    if (tail->kind == SB_NODE_END) {
+      ok = read_input(&r, tail, 2, result);
+      break;
+    }
+
+    if (tail->kind == SB_NODE_BRANCH) {
+      uint64_t predicate;
+
+      if (!read_input(&r, tail, 1, &predicate)) {
+        ok = false;
+        break;
+      }
+
+      SB_Node* proj = taken_proj(func, tail, predicate != 0);
+
+      if (!proj || schedule->block_of[proj->id] < 0) {
+        ok = run_error(tail, "the taken side was not scheduled");
+        break;
+      }
+
+      b = schedule->block_of[proj->id];
+      continue;
+    }
+
+    // Anything else falls into a region.
+    SB_Node* region = NULL;
+    int32_t index = 0;
+
+    for (int32_t i = 0; i < tail->num_uses; ++i) {
+      SB_Node* user = sb_user(func, &tail->uses[i]);
+
+      if (user->kind == SB_NODE_REGION && schedule->block_of[user->id] >= 0) {
+        region = user;
+        index = tail->uses[i].index;
+        break;
+      }
+    }
+
+    if (!region) {
+      ok = run_error(tail, "control falls off the end of the block");
+      break;
+    }
+
+    b = schedule->block_of[region->id];
+    ok = enter_block(&r, &schedule->blocks[b], index);
+  }
+
+  scratch_release(&scratch);
+
+  return ok;
+}
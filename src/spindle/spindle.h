@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 
 #define X(name, ...) SB_NODE_##name,
@@ -11,12 +12,7 @@ typedef enum {
 } SB_NodeKind;
 #undef X
 
-#define X(name, label, ...) label,
-static char* sb_node_kind_label[] = {
-  "!!uninitialized!!",
-  #include "node_kind.def"
-};
-#undef X
+extern const char* sb_node_kind_label[NUM_SB_NODE_KINDS];
 
 typedef struct SB_Use  SB_Use;
 typedef struct SB_Node SB_Node;
@@ -29,15 +25,17 @@ typedef enum {
   SB_FLAG_IS_CFG = SB_BIT(1),
   SB_FLAG_READS_MEM = SB_BIT(2),
   SB_FLAG_HAS_MEM_DEP = SB_BIT(3),
+  SB_FLAG_IN_VALUE_TABLE = SB_BIT(4),
 } SB_Flags;
 
+// Uses name their user by id, see sb_user().
 struct SB_Use {
-  SB_Use* next;
-
+  int32_t user;
   int32_t index;
-  SB_Node* node;
 };
 
+#define SB_INLINE_USES 2
+
 struct SB_Node {
   int32_t id;
   SB_Flags flags;
@@ -45,27 +43,58 @@ struct SB_Node {
   SB_NodeKind kind;
 
   int32_t num_ins;
-  SB_Node** ins;
+  int32_t* ins;       // input ids, 0 where an input is absent, see sb_in()
+  int32_t* use_slots; // where each input keeps our use in its 'uses' array
 
+  int32_t num_uses;
+  int32_t use_capacity;
   SB_Use* uses;
+  SB_Use inline_uses[SB_INLINE_USES];
 };
 
 typedef struct SB_Context SB_Context;
+typedef struct SB_ValueSlot SB_ValueSlot;
+typedef struct Arena Arena;
 
 typedef struct {
   SB_Context* context;
+
+  Arena* arena; // nodes and their input/use arrays, nothing else
+  SB_Node** nodes; // Vec indexed by id, NULL once a node is dead
   int32_t next_id;
+  int32_t num_live;
+
+  // Value numbering over pure data nodes, heap allocated.
+  SB_ValueSlot* value_slots;
+  uint32_t value_mask;
+  int32_t num_values;
 
-  SB_Node* start;
-  SB_Node* end;
+  int32_t start; // node ids, 0 until created
+  int32_t end;
 } SB_Func;
 
+static inline SB_Node* sb_in(SB_Func* func, SB_Node* node, int32_t index) {
+  return func->nodes[node->ins[index]];
+}
+
+static inline SB_Node* sb_func_start(SB_Func* func) {
+  return func->nodes[func->start];
+}
+
+static inline SB_Node* sb_func_end(SB_Func* func) {
+  return func->nodes[func->end];
+}
+
 SB_Context* sb_init();
 void sb_cleanup(SB_Context* ctx);
 
 SB_Func* sb_begin_func(SB_Context* ctx);
 void sb_finish_func(SB_Func* func);
 
+// Moves the live graph into fresh storage with dense ids. Invalidates every
+// SB_Node pointer into the function.
+void sb_compact_func(SB_Func* func);
+
 void sb_graphviz_func(FILE* stream, SB_Func* func);
 
 SB_Node* sb_node_start(SB_Func* func);
@@ -76,6 +105,9 @@ SB_Node* sb_node_end(SB_Func* func, SB_Node* ctrl, SB_Node* mem, SB_Node* return
 
 SB_Node* sb_node_null(SB_Func* func);
 
+// Control that is never reached, e.g. the side of a branch that can not be taken.
+SB_Node* sb_node_dead(SB_Func* func);
+
 SB_Node* sb_node_region(SB_Func* func);
 void sb_set_region_ins(SB_Func* func, SB_Node* region, int32_t num_ins, SB_Node** ins);
 
@@ -100,4 +132,30 @@ SB_Node* sb_node_sub(SB_Func* func, SB_Node* lhs, SB_Node* rhs);
 SB_Node* sb_node_mul(SB_Func* func, SB_Node* lhs, SB_Node* rhs);
 SB_Node* sb_node_sdiv(SB_Func* func, SB_Node* lhs, SB_Node* rhs);
 
-void sb_opt(SB_Context* ctx, SB_Func* func);
\ No newline at end of file
+void sb_opt(SB_Context* ctx, SB_Func* func);
+
+// A basic block: its phis, then its other nodes in an order that respects
+// their inputs, then the BRANCH or END that ends it, if any.
+typedef struct {
+  SB_Node* head; // START, REGION or a branch projection
+  SB_Node* tail; // last control node in the block
+  int32_t num_nodes;
+  SB_Node** nodes;
+} SB_Block;
+
+typedef struct {
+  int32_t num_blocks;
+  SB_Block* blocks;  // reverse post order, START's block first
+  int32_t* block_of; // by node id, -1 for nodes that are not scheduled
+} SB_Schedule;
+
+// Places every live node in a block with global code motion. The schedule
+// lives in 'arena' and is only valid until the graph changes.
+SB_Schedule sb_schedule_func(Arena* arena, SB_Func* func);
+void sb_print_schedule(FILE* stream, SB_Func* func, SB_Schedule* schedule);
+
+// Executes a schedule and stores what END returns in 'result'. Fails, and
+// says why on stderr, on division by zero, on a use whose definition has not
+// run yet and on a function that does not seem to terminate. The tests use
+// it to check the optimizer and scheduler against the source program.
+bool sb_run_schedule(SB_Func* func, SB_Schedule* schedule, uint64_t* result);
\ No newline at end of file
@@ -17,12 +17,27 @@ typedef struct {
   ScratchImpl* impl;
 } Scratch;
 
+// Only scratch_release applies the policy, to the scratch arenas of the
+// calling thread. It is shared by every thread, so set it before starting
+// any. Long-lived arenas are never trimmed behind the caller's back, call
+// arena_trim on them instead.
+typedef struct {
+  size_t high_water; // committed bytes at which scratch_release trims an arena
+  size_t retain;     // committed bytes left behind by that trim
+} ArenaDecommitPolicy;
+
 Arena* new_arena();
 void free_arena(Arena* arena);
 
 void* arena_push(Arena* arena, size_t amount);
 void* arena_zeroed(Arena* arena, size_t amount);
 
+bool arena_resize(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+
+void arena_trim(Arena* arena, size_t keep_bytes);
+size_t arena_committed(Arena* arena);
+void arena_set_decommit_policy(ArenaDecommitPolicy policy);
+
 void init_scratch_arenas();
 void free_scratch_arenas();
 
@@ -32,7 +47,7 @@ void scratch_release(Scratch* scratch);
 #define arena_array(arena, type, count) ((type*)arena_zeroed(arena, (count) * sizeof(type)))
 #define arena_type(arena, type) ((type*)arena_zeroed(arena, sizeof(type)))
 
-inline void* ptr_byte_add(void* ptr, int64_t offset) {
+static inline void* ptr_byte_add(void* ptr, int64_t offset) {
   return (uint8_t*)ptr + offset;
 }
 
@@ -41,45 +56,84 @@ typedef struct {
   size_t len;
 } Str;
 
-char* load_text_file(Arena* arena, const char* path);
+// A source file mapped read-only and followed by at least one zero byte, so
+// it can be scanned like a NUL-terminated string without being copied.
+typedef struct {
+  char* data;
+  size_t length;
+  size_t mapping_size; // 0 when the file had to be read into a heap buffer
+} MappedFile;
+
+bool map_text_file(MappedFile* file, const char* path);
+void unmap_text_file(MappedFile* file);
+
+int get_processor_count();
 
 #define Vec(T) T*
 
-void* _vec_put(void* vec, size_t stride);
+typedef struct {
+  int length;
+  int capacity;
+  Arena* arena; // NULL for heap vectors
+} VecHeader;
+
+#define vec_hdr(v) ((VecHeader*)ptr_byte_add(v, -(int64_t)sizeof(VecHeader)))
+
+void* _vec_grow(void* vec, size_t stride);
+void* _vec_new_in_arena(Arena* arena, size_t stride);
 void vec_free(void* vec);
 
-int vec_len(void* vec);
 int _vec_pop(void* vec);
 
 void* _vec_bake(Arena* arena, void* vec, size_t stride);
 
 void vec_clear(void* vec);
 
-#define vec_put(v, x) ( *(void**)(&(v)) = _vec_put(v, sizeof((v)[0])), (v)[vec_len(v)-1] = (x), (void)0 )
+static inline int vec_len(void* vec) {
+  return vec ? vec_hdr(vec)->length : 0;
+}
+
+static inline bool vec_full(void* vec) {
+  return !vec || vec_hdr(vec)->length == vec_hdr(vec)->capacity;
+}
+
+#define vec_put(v, x) \
+  do { \
+    if (vec_full(v)) { \
+      *(void**)(&(v)) = _vec_grow(v, sizeof((v)[0])); \
+    } \
+    (v)[vec_hdr(v)->length] = (x); \
+    vec_hdr(v)->length++; \
+  } while (false)
+
 #define vec_pop(v) ((v)[_vec_pop(v)])
 #define vec_bake(arena, v) (*(void**)(&(v)) = _vec_bake(arena, v, sizeof((v)[0])), v)
 #define vec_back(v) (assert(vec_len(v)), &(v)[vec_len(v)-1] )
 
-static size_t bitset_num_u64(size_t num_bits) {
+// Arena vectors grow in place while they sit at the top of their arena,
+// and baking them into that same arena is free.
+#define vec_in_arena(v, arena) (*(void**)(&(v)) = _vec_new_in_arena(arena, sizeof((v)[0])), (void)0)
+
+static inline size_t bitset_num_u64(size_t num_bits) {
   return (num_bits+63)/64;
 }
 
-static bool bitset_get(uint64_t* set, size_t index) {
+static inline bool bitset_get(uint64_t* set, size_t index) {
   return (set[index/64] >> (index%64)) & 1;
 }
 
-static void bitset_set(uint64_t* set, size_t index) {
+static inline void bitset_set(uint64_t* set, size_t index) {
   set[index/64] |= (uint64_t)1 << (index%64);
 }
 
-static void bitset_unset(uint64_t* set, size_t index) {
+static inline void bitset_unset(uint64_t* set, size_t index) {
   set[index/64] &= ~((uint64_t)1 << (index%64));
 }
 
-inline void init_thread() {
+static inline void init_thread() {
   init_scratch_arenas();
 }
 
-inline void cleanup_thread() {
+static inline void cleanup_thread() {
   free_scratch_arenas();
 }
\ No newline at end of file
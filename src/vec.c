@@ -4,63 +4,81 @@
 
 #define INITIAL_CAP 8
 
-typedef struct {
-  int length;
-  int capacity;
-} Header;
-
 static int grow_capacity(int c) {
-  return c ? c * 2 : 8;
+  return c ? c * 2 : INITIAL_CAP;
 }
 
-static Header* hdr(void* vec) {
-  return ptr_byte_add(vec, -(int64_t)sizeof(Header));
+static size_t vec_size(int capacity, size_t stride) {
+  return sizeof(VecHeader) + capacity * stride;
 }
 
-void* _vec_put(void* vec, size_t stride) {
-  Header* h;
-
-  if (vec) {
-    h = hdr(vec);
-  }
-  else {
-    h = malloc(sizeof(Header) + INITIAL_CAP * stride);
+void* _vec_grow(void* vec, size_t stride) {
+  if (!vec) {
+    VecHeader* h = malloc(vec_size(INITIAL_CAP, stride));
     h->length = 0;
     h->capacity = INITIAL_CAP;
+    h->arena = NULL;
+    return ptr_byte_add(h, sizeof(VecHeader));
   }
 
-  if (h->length == h->capacity) {
-    h->capacity = grow_capacity(h->capacity);
-    h = realloc(h, sizeof(Header) + h->capacity * stride);
+  VecHeader* h = vec_hdr(vec);
+
+  int new_capacity = grow_capacity(h->capacity);
+
+  if (h->arena) {
+    size_t old_size = vec_size(h->capacity, stride);
+    size_t new_size = vec_size(new_capacity, stride);
+
+    if (!arena_resize(h->arena, h, old_size, new_size)) {
+      VecHeader* moved = arena_push(h->arena, new_size);
+      memcpy(moved, h, old_size);
+      h = moved;
+    }
+  }
+  else {
+    h = realloc(h, vec_size(new_capacity, stride));
   }
 
-  h->length++;
+  h->capacity = new_capacity;
 
-  return ptr_byte_add(h, sizeof(Header));
+  return ptr_byte_add(h, sizeof(VecHeader));
 }
 
-void vec_free(void* vec) {
-  if (vec) {
-    free(hdr(vec));
-  }
+void* _vec_new_in_arena(Arena* arena, size_t stride) {
+  VecHeader* h = arena_push(arena, vec_size(INITIAL_CAP, stride));
+  h->length = 0;
+  h->capacity = INITIAL_CAP;
+  h->arena = arena;
+  return ptr_byte_add(h, sizeof(VecHeader));
 }
 
-int vec_len(void* vec) {
-  if (vec) {
-    return hdr(vec)->length;
+void vec_free(void* vec) {
+  if (!vec) {
+    return;
   }
-  else {
-    return 0;
+
+  VecHeader* h = vec_hdr(vec);
+
+  if (!h->arena) {
+    free(h);
   }
 }
 
 int _vec_pop(void* vec) {
-  Header* h = hdr(vec);
+  VecHeader* h = vec_hdr(vec);
   assert(h->length);
   return --h->length;
 }
 
 void* _vec_bake(Arena* arena, void* vec, size_t stride) {
+  if (vec && vec_hdr(vec)->arena == arena) {
+    // Already in place, just hand back the unused capacity if we can.
+    VecHeader* h = vec_hdr(vec);
+    arena_resize(arena, h, vec_size(h->capacity, stride), vec_size(h->length, stride));
+    h->capacity = h->length;
+    return vec;
+  }
+
   size_t sz = vec_len(vec) * stride;
   void* data = arena_push(arena, sz);
 
@@ -73,6 +91,6 @@ void* _vec_bake(Arena* arena, void* vec, size_t stride) {
 
 void vec_clear(void* vec) {
   if (vec) {
-    hdr(vec)->length = 0;
+    vec_hdr(vec)->length = 0;
   }
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "utility.h"
+
+// Scratch arenas that grew past the policy's high water go back down to
+// 'retain' committed bytes when released, and stay usable afterwards.
+
+#define MB ((size_t)1024 * 1024)
+
+// Multiples of a huge page, so the trimmed size is exact either way.
+#define HIGH_WATER (8 * MB)
+#define RETAIN (2 * MB)
+
+static int failures;
+
+static void expect(bool ok, const char* message) {
+  if (!ok) {
+    fprintf(stderr, "arena_decommit: %s\n", message);
+    failures++;
+  }
+}
+
+// Pushes and touches 'amount' bytes, so that they are really committed.
+static void fill(Arena* arena, size_t amount, int value) {
+  memset(arena_push(arena, amount), value, amount);
+}
+
+int main() {
+  init_thread();
+
+  arena_set_decommit_policy((ArenaDecommitPolicy) {
+    .high_water = HIGH_WATER,
+    .retain = RETAIN
+  });
+
+  // Under the high water nothing is given back.
+  Scratch scratch = scratch_get(0, NULL);
+  Arena* arena = scratch.arena;
+
+  fill(arena, 6 * MB, 1);
+  scratch_release(&scratch);
+
+  expect(arena_committed(arena) >= 6 * MB, "trimmed below the high water");
+
+  // Past it the arena drops back to what the policy retains, also when it
+  // has been trimmed before.
+  for (int round = 0; round < 2; ++round) {
+    scratch = scratch_get(0, NULL);
+    fill(scratch.arena, 32 * MB, 2);
+
+    expect(arena_committed(scratch.arena) >= 32 * MB, "did not commit what was pushed");
+
+    scratch_release(&scratch);
+
+    expect(arena_committed(arena) == RETAIN, "did not drop back to the retained size");
+  }
+
+  // An outer scratch keeps its bytes when an inner one is trimmed.
+  Scratch outer = scratch_get(0, NULL);
+  uint8_t* kept = arena_push(outer.arena, 3 * MB);
+  memset(kept, 3, 3 * MB);
+
+  Scratch inner = scratch_get(0, NULL);
+  expect(inner.arena == outer.arena, "expected the same scratch arena");
+
+  fill(inner.arena, 32 * MB, 4);
+  scratch_release(&inner);
+
+  size_t committed = arena_committed(arena);
+  expect(committed >= 3 * MB && committed < HIGH_WATER, "did not trim down to the live scratch");
+  expect(kept[0] == 3 && kept[3 * MB - 1] == 3, "lost the outer scratch's bytes");
+
+  scratch_release(&outer);
+
+  // Arenas outside the scratch pool are left alone.
+  Arena* long_lived = new_arena();
+  fill(long_lived, 32 * MB, 5);
+
+  scratch = scratch_get(0, NULL);
+  scratch_release(&scratch);
+
+  expect(arena_committed(long_lived) >= 32 * MB, "trimmed an arena that is not scratch");
+
+  free_arena(long_lived);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+#include "front/front.h"
+
+// Lexing in chunks must give the tokens and symbol ids of a serial lex,
+// wherever the chunk boundaries fall.
+
+#define SOURCE_SIZE ((size_t)9 * 1024 * 1024)
+#define MAX_CHUNKS 12
+
+static const char* names[] = {
+  "a", "b2", "counter", "value_of_the_thing", "_tmp", "x", "total", "while_", "iff",
+};
+
+static const char* lines[] = {
+  "%s: int;\n",
+  "%s = %s + %d * %s;\n",
+  "while %s - %d { %s = %s / 2; }\n",
+  "if %s { return %s; }\n",
+  "// %s stays the same\n",
+  "\n\n  \t\n",
+};
+
+static uint32_t next_random(uint32_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Identifiers first appear all over the source, so a chunk boundary
+// usually falls between two appearances of the same name.
+static char* generate_source(size_t length) {
+  char* source = malloc(length + 1);
+  size_t at = 0;
+
+  uint32_t state = 0x9e3779b9;
+
+  while (true) {
+    char line[256];
+    char fresh[32];
+
+    snprintf(fresh, sizeof(fresh), "name_%u", next_random(&state) % 5000);
+
+    const char* a = next_random(&state) % 4 ? names[next_random(&state) % ARRAY_LENGTH(names)] : fresh;
+    const char* b = names[next_random(&state) % ARRAY_LENGTH(names)];
+    int number = (int)(next_random(&state) % 1000);
+
+    switch (next_random(&state) % ARRAY_LENGTH(lines)) {
+      case 0: snprintf(line, sizeof(line), lines[0], a); break;
+      case 1: snprintf(line, sizeof(line), lines[1], a, b, number, a); break;
+      case 2: snprintf(line, sizeof(line), lines[2], a, number, b, a); break;
+      case 3: snprintf(line, sizeof(line), lines[3], a, b); break;
+      case 4: snprintf(line, sizeof(line), lines[4], a); break;
+      default: snprintf(line, sizeof(line), "%s", lines[5]); break;
+    }
+
+    size_t line_length = strlen(line);
+
+    if (at + line_length > length) {
+      break;
+    }
+
+    memcpy(source + at, line, line_length);
+    at += line_length;
+  }
+
+  memset(source + at, ' ', length - at);
+  source[length] = '\0';
+
+  return source;
+}
+
+static bool same_tokens(Interner* expected_interner, Tokens expected, Interner* interner, Tokens tokens) {
+  if (!tokens.data || tokens.count != expected.count) {
+    return false;
+  }
+
+  if (memcmp(tokens.data, expected.data, expected.count * sizeof(Token)) != 0) {
+    return false;
+  }
+
+  if (memcmp(tokens.symbols, expected.symbols, expected.count * sizeof(Symbol)) != 0) {
+    return false;
+  }
+
+  if (num_symbols(interner) != num_symbols(expected_interner)) {
+    return false;
+  }
+
+  for (int i = 0; i < num_symbols(interner); ++i) {
+    Str a = symbol_text(interner, i);
+    Str b = symbol_text(expected_interner, i);
+
+    if (a.len != b.len || memcmp(a.s, b.s, a.len) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main() {
+  init_thread();
+
+  int failures = 0;
+
+  char* source = generate_source(SOURCE_SIZE);
+
+  Arena* serial_arena = new_arena();
+  Interner* serial_interner = new_interner();
+  Tokens serial = lex_source_chunks(serial_arena, serial_interner, "serial", source, SOURCE_SIZE, 1);
+
+  if (!serial.data) {
+    fprintf(stderr, "lex_parallel: the generated source failed to lex\n");
+    return 1;
+  }
+
+  for (int num_chunks = 0; num_chunks <= MAX_CHUNKS; ++num_chunks) {
+    Arena* arena = new_arena();
+    Interner* interner = new_interner();
+
+    // 0 stands for lex_source's own choice.
+    Tokens tokens = num_chunks
+      ? lex_source_chunks(arena, interner, "parallel", source, SOURCE_SIZE, num_chunks)
+      : lex_source(arena, interner, "parallel", source, SOURCE_SIZE);
+
+    if (!same_tokens(serial_interner, serial, interner, tokens)) {
+      fprintf(stderr, "lex_parallel: %d chunks differ from a serial lex\n", num_chunks);
+      failures++;
+    }
+
+    free_interner(interner);
+    free_arena(arena);
+  }
+
+  free_interner(serial_interner);
+  free_arena(serial_arena);
+  free(source);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}
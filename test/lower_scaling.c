@@ -0,0 +1,116 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+#include "front/front.h"
+#include "spindle/spindle.h"
+
+// SSA construction on a long function with an if per statement. Blocks and
+// places both grow with the length, so anything that sizes a table by
+// their product runs out of address space long before the end.
+
+#define NUM_STATEMENTS 12000
+
+static uint32_t state = 0xc2b2ae35;
+
+static uint32_t next_random() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static char* text;
+static size_t text_length;
+static size_t text_capacity;
+
+static void emit(const char* fmt, ...) {
+  char buffer[128];
+
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+
+  if (text_length + (size_t)length + 1 > text_capacity) {
+    text_capacity = (text_length + (size_t)length + 1) * 2;
+    text = realloc(text, text_capacity);
+  }
+
+  memcpy(text + text_length, buffer, (size_t)length + 1);
+  text_length += (size_t)length;
+}
+
+int main() {
+  init_thread();
+
+  // Keeps 'a' and 'b' alive across every join, and works out what the
+  // program returns along the way.
+  int64_t a = 0;
+  int64_t b = 1;
+
+  emit("{\na: int;\nb: int;\na = 0;\nb = 1;\n");
+
+  for (int i = 0; i < NUM_STATEMENTS; ++i) {
+    int64_t k = next_random() % 8;
+    int64_t n = next_random() % 5 + 1;
+
+    if (next_random() % 2) {
+      emit("if a - %lld { a = a + %lld; } else { b = b + a; }\n", (long long)k, (long long)n);
+
+      if (a - k) {
+        a += n;
+      }
+      else {
+        b += a;
+      }
+    }
+    else {
+      emit("if b - %lld { b = b - a / %lld; }\n", (long long)k, (long long)n);
+
+      if (b - k) {
+        b -= a / n;
+      }
+    }
+  }
+
+  emit("return a + b;\n}\n");
+
+  Arena* arena = new_arena();
+  Interner* interner = new_interner();
+
+  Tokens tokens = lex_source(arena, interner, "lower_scaling", text, text_length);
+  ParseTree* tree = tokens.data ? parse(arena, tokens, "lower_scaling", text) : NULL;
+  SemFunc* func = tree ? check_tree(arena, "lower_scaling", text, tree) : NULL;
+
+  if (!func || !sem_analyze_func("lower_scaling", text, func)) {
+    fprintf(stderr, "lower_scaling: the generated program was rejected\n");
+    return 1;
+  }
+
+  int failures = 0;
+
+  SB_Context* sb = sb_init();
+  SB_Func* sb_func = lower_sem_func(sb, func, LOWER_SSA);
+
+  sb_opt(sb, sb_func);
+
+  SB_Schedule schedule = sb_schedule_func(arena, sb_func);
+  uint64_t result = 0;
+
+  if (!sb_run_schedule(sb_func, &schedule, &result) || result != (uint64_t)(a + b)) {
+    fprintf(stderr, "lower_scaling: expected the program to return %lld\n", (long long)(a + b));
+    failures++;
+  }
+
+  free_sem_func_storage(func);
+  free_interner(interner);
+  free_arena(arena);
+  free(text);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}
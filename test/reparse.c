@@ -0,0 +1,436 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+#include "front/front.h"
+
+// Random edits of a generated program. After each one, relex_source and
+// reparse must give the tokens and tree that lex_source and parse give on
+// the new text. Every edit keeps the program well formed, so each step
+// has a tree to start the next one from.
+
+#define NUM_EDITS 3000
+#define MAX_DEPTH 3
+
+static uint32_t state = 0x1b873593;
+
+static uint32_t next_random() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static const char* names[] = {
+  "a", "b", "count", "x2", "_t", "value", "elsewhere", "iffy",
+};
+
+typedef struct {
+  char* data;
+  size_t length;
+  size_t capacity;
+} Text;
+
+static void text_append(Text* text, const char* s, size_t length) {
+  if (text->length + length + 1 > text->capacity) {
+    text->capacity = (text->length + length + 1) * 2;
+    text->data = realloc(text->data, text->capacity);
+  }
+
+  memcpy(text->data + text->length, s, length);
+  text->length += length;
+  text->data[text->length] = '\0';
+}
+
+static void text_print(Text* text, const char* fmt, ...) {
+  char buffer[256];
+
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+
+  text_append(text, buffer, (size_t)length);
+}
+
+static const char* random_name() {
+  return names[next_random() % ARRAY_LENGTH(names)];
+}
+
+static void gen_expr(Text* text, int depth) {
+  if (depth >= 2 || next_random() % 2) {
+    if (next_random() % 2) {
+      text_print(text, "%s", random_name());
+    }
+    else {
+      text_print(text, "%u", next_random() % 100);
+    }
+    return;
+  }
+
+  gen_expr(text, depth + 1);
+  text_print(text, " %c ", "+-*/"[next_random() % 4]);
+  gen_expr(text, depth + 1);
+}
+
+static void gen_stmt(Text* text, int depth);
+
+static void gen_block(Text* text, int depth) {
+  text_print(text, "{\n");
+
+  int count = (int)(next_random() % 3);
+
+  for (int i = 0; i < count; ++i) {
+    gen_stmt(text, depth + 1);
+  }
+
+  text_print(text, "}");
+}
+
+static void gen_stmt(Text* text, int depth) {
+  int kind = (int)(next_random() % (depth < MAX_DEPTH ? 8 : 4));
+
+  switch (kind) {
+    case 0:
+      text_print(text, "%s: int;", random_name());
+      break;
+    case 1:
+      text_print(text, "%s: int = ", random_name());
+      gen_expr(text, 0);
+      text_print(text, ";");
+      break;
+    case 2:
+      text_print(text, "%s = ", random_name());
+      gen_expr(text, 0);
+      text_print(text, ";");
+      break;
+    case 3:
+      text_print(text, "return ");
+      gen_expr(text, 0);
+      text_print(text, "; // done");
+      break;
+    case 4:
+    case 5:
+      text_print(text, "if ");
+      gen_expr(text, 0);
+      text_print(text, " ");
+      gen_block(text, depth);
+
+      if (kind == 5) {
+        text_print(text, " else ");
+        gen_block(text, depth);
+      }
+      break;
+    case 6:
+      text_print(text, "while ");
+      gen_expr(text, 0);
+      text_print(text, " ");
+      gen_block(text, depth);
+      break;
+    default:
+      gen_block(text, depth);
+      break;
+  }
+
+  text_print(text, "\n");
+}
+
+// One step of the edited program, everything in it lives in 'arena'.
+typedef struct {
+  Arena* arena;
+  char* source;
+  size_t length;
+  Tokens tokens;
+  ParseTree* tree;
+} Version;
+
+static int failures;
+
+static void fail(int edit, const char* message) {
+  fprintf(stderr, "reparse: edit %d: %s\n", edit, message);
+  failures++;
+}
+
+static bool same_symbol(Interner* a_interner, Symbol a, Interner* b_interner, Symbol b) {
+  if (a == SYMBOL_NONE || b == SYMBOL_NONE) {
+    return a == b;
+  }
+
+  Str a_text = symbol_text(a_interner, a);
+  Str b_text = symbol_text(b_interner, b);
+
+  return a_text.len == b_text.len && memcmp(a_text.s, b_text.s, a_text.len) == 0;
+}
+
+static bool same_tokens(Interner* a_interner, Tokens a, Interner* b_interner, Tokens b) {
+  if (a.count != b.count) {
+    return false;
+  }
+
+  for (int i = 0; i < a.count; ++i) {
+    Token x = a.data[i];
+    Token y = b.data[i];
+
+    if (x.offset != y.offset || x.length != y.length || x.kind != y.kind) {
+      return false;
+    }
+
+    if (!same_symbol(a_interner, a.symbols[i], b_interner, b.symbols[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool same_tree(Interner* a_interner, ParseTree* a, Interner* b_interner, ParseTree* b) {
+  if (a->num_nodes != b->num_nodes || a->num_stmts != b->num_stmts) {
+    return false;
+  }
+
+  for (int i = 0; i < a->num_nodes; ++i) {
+    ParseNode* x = &a->nodes[i];
+    ParseNode* y = &b->nodes[i];
+
+    if (x->kind != y->kind || x->num_children != y->num_children || x->subtree_size != y->subtree_size) {
+      return false;
+    }
+
+    if (x->token.offset != y->token.offset || x->token.length != y->token.length || x->token.kind != y->token.kind) {
+      return false;
+    }
+
+    if (!same_symbol(a_interner, x->symbol, b_interner, y->symbol)) {
+      return false;
+    }
+  }
+
+  for (int i = 0; i < a->num_stmts; ++i) {
+    ParseStmtSpan x = a->stmts[i];
+    ParseStmtSpan y = b->stmts[i];
+
+    if (x.first_token != y.first_token || x.num_tokens != y.num_tokens || x.root != y.root) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static uint32_t token_end(Token token) {
+  return token.offset + token.length;
+}
+
+// The 'else' that belongs to the if statement 'span', or -1.
+static int find_else(Tokens tokens, ParseStmtSpan span) {
+  int depth = 0;
+
+  for (int i = span.first_token; i < span.first_token + span.num_tokens; ++i) {
+    int kind = tokens.data[i].kind;
+
+    depth += kind == '{';
+    depth -= kind == '}';
+
+    if (depth == 0 && kind == TOKEN_KEYWORD_ELSE) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static TextEdit replace(uint32_t offset, uint32_t removed, Text* inserted) {
+  return (TextEdit) {
+    .offset = offset,
+    .removed = removed,
+    .inserted = (uint32_t)inserted->length
+  };
+}
+
+// Picks an edit of 'v' and writes its replacement text to 'inserted'.
+static TextEdit choose_edit(Version* v, Text* inserted) {
+  Tokens tokens = v->tokens;
+  ParseTree* tree = v->tree;
+
+  while (true) {
+    int token = (int)(next_random() % (uint32_t)(tokens.count - 1));
+    Token tok = tokens.data[token];
+
+    ParseStmtSpan span = {0};
+    uint32_t span_begin = 0;
+    uint32_t span_end = 0;
+
+    if (tree->num_stmts) {
+      span = tree->stmts[next_random() % (uint32_t)tree->num_stmts];
+      span_begin = tokens.data[span.first_token].offset;
+      span_end = token_end(tokens.data[span.first_token + span.num_tokens - 1]);
+    }
+
+    switch (next_random() % 8) {
+      case 0:
+        if (tok.kind != TOKEN_IDENTIFIER) {
+          continue;
+        }
+        text_print(inserted, "%s", random_name());
+        return replace(tok.offset, tok.length, inserted);
+
+      case 1:
+        if (tok.kind != TOKEN_INTEGER) {
+          continue;
+        }
+        text_print(inserted, next_random() % 2 ? "%u" : "%u + 1", next_random() % 1000);
+        return replace(tok.offset, tok.length, inserted);
+
+      case 2:
+        text_print(inserted, next_random() % 2 ? " " : "\n  ");
+        return replace(tok.offset, 0, inserted);
+
+      case 3:
+        if (!tree->num_stmts) {
+          continue;
+        }
+        gen_stmt(inserted, 1);
+        return replace(span_begin, 0, inserted);
+
+      case 4:
+        if (!tree->num_stmts) {
+          continue;
+        }
+        return replace(span_begin, span_end - span_begin, inserted);
+
+      case 5:
+        if (!tree->num_stmts) {
+          continue;
+        }
+        gen_stmt(inserted, 1);
+        inserted->length--; // the statement's own newline
+        return replace(span_begin, span_end - span_begin, inserted);
+
+      case 6: {
+        if (!tree->num_stmts || tree->nodes[span.root].kind != PARSE_NODE_IF || find_else(tokens, span) >= 0) {
+          continue;
+        }
+        // Typed on the line after the if, the damage starts right after it.
+        if (next_random() % 2) {
+          text_print(inserted, "else ");
+          gen_block(inserted, 1);
+          text_print(inserted, "\n");
+          return replace(tokens.data[span.first_token + span.num_tokens].offset, 0, inserted);
+        }
+
+        text_print(inserted, " else ");
+        gen_block(inserted, 1);
+        return replace(span_end, 0, inserted);
+      }
+
+      default: {
+        int else_token = tree->num_stmts && tree->nodes[span.root].kind == PARSE_NODE_IF ? find_else(tokens, span) : -1;
+
+        if (else_token < 0) {
+          continue;
+        }
+
+        uint32_t begin = tokens.data[else_token].offset;
+        return replace(begin, span_end - begin, inserted);
+      }
+    }
+  }
+}
+
+static char* apply_edit(Version* v, TextEdit edit, const char* inserted, size_t* length) {
+  *length = v->length - edit.removed + edit.inserted;
+  char* source = malloc(*length + 1);
+
+  memcpy(source, v->source, edit.offset);
+  memcpy(source + edit.offset, inserted, edit.inserted);
+  memcpy(source + edit.offset + edit.inserted, v->source + edit.offset + edit.removed, v->length - edit.offset - edit.removed);
+  source[*length] = '\0';
+
+  return source;
+}
+
+int main() {
+  init_thread();
+
+  Interner* interner = new_interner();
+
+  Text program = {0};
+  text_print(&program, "{\n");
+
+  for (int i = 0; i < 40; ++i) {
+    gen_stmt(&program, 1);
+  }
+
+  text_print(&program, "}\n");
+
+  Version v = {
+    .arena = new_arena(),
+    .source = program.data,
+    .length = program.length
+  };
+
+  v.tokens = lex_source(v.arena, interner, "reparse", v.source, v.length);
+  v.tree = v.tokens.data ? parse(v.arena, v.tokens, "reparse", v.source) : NULL;
+
+  if (!v.tree) {
+    fprintf(stderr, "reparse: the generated program failed to parse\n");
+    return 1;
+  }
+
+  for (int i = 0; i < NUM_EDITS; ++i) {
+    Text inserted = {0};
+    text_append(&inserted, "", 0);
+
+    TextEdit edit = choose_edit(&v, &inserted);
+
+    Version next = { .arena = new_arena() };
+    next.source = apply_edit(&v, edit, inserted.data, &next.length);
+
+    free(inserted.data);
+
+    TokenDamage damage;
+    next.tokens = relex_source(next.arena, interner, "reparse", next.source, v.tokens, edit, &damage);
+    next.tree = next.tokens.data ? reparse(next.arena, v.tree, next.tokens, damage, "reparse", next.source) : NULL;
+
+    Arena* arena = new_arena();
+    Interner* fresh_interner = new_interner();
+
+    Tokens tokens = lex_source(arena, fresh_interner, "reparse", next.source, next.length);
+    ParseTree* tree = tokens.data ? parse(arena, tokens, "reparse", next.source) : NULL;
+
+    if (!tree) {
+      fail(i, "the edited program failed to parse");
+    }
+    else if (!next.tree) {
+      fail(i, "reparse failed where parse succeeded");
+    }
+    else if (!same_tokens(interner, next.tokens, fresh_interner, tokens)) {
+      fail(i, "relex_source and lex_source disagree");
+    }
+    else if (!same_tree(interner, next.tree, fresh_interner, tree)) {
+      fail(i, "reparse and parse disagree");
+    }
+
+    free_interner(fresh_interner);
+    free_arena(arena);
+
+    free(v.source);
+    free_arena(v.arena);
+
+    v = next;
+
+    if (failures || !v.tree) {
+      break;
+    }
+  }
+
+  free(v.source);
+  free_arena(v.arena);
+  free_interner(interner);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}
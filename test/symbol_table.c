@@ -0,0 +1,206 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utility.h"
+#include "front/front.h"
+
+// Name lookup in the checker across nested blocks. A random program of
+// declarations, copies and blocks is checked against a model of which
+// place every visible name refers to. Enough names are live at once to
+// grow the table, and leaving blocks deletes many of them again.
+
+#define NUM_NAMES 1000
+#define NUM_ACTIONS 40000
+#define MAX_DEPTH 10
+
+static uint32_t state = 0x85ebca6b;
+
+static uint32_t next_random() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static char* text;
+static size_t text_length;
+static size_t text_capacity;
+
+static void emit(const char* fmt, ...) {
+  char buffer[128];
+
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+
+  if (text_length + (size_t)length + 1 > text_capacity) {
+    text_capacity = (text_length + (size_t)length + 1) * 2;
+    text = realloc(text, text_capacity);
+  }
+
+  memcpy(text + text_length, buffer, (size_t)length + 1);
+  text_length += (size_t)length;
+}
+
+typedef struct {
+  SemPlace write;
+  SemPlace read;
+} Copy;
+
+static int failures;
+
+// Checks 'source' and returns the function, or NULL if the checker rejected it.
+static SemFunc* check_source(Arena* arena, const char* source) {
+  Interner* interner = new_interner();
+  Tokens tokens = lex_source(arena, interner, "symbol_table", source, strlen(source));
+  ParseTree* tree = tokens.data ? parse(arena, tokens, "symbol_table", source) : NULL;
+  SemFunc* func = tree ? check_tree(arena, "symbol_table", source, tree) : NULL;
+  free_interner(interner);
+  return func;
+}
+
+static void expect_checked(const char* source, bool ok) {
+  Arena* arena = new_arena();
+  SemFunc* func = check_source(arena, source);
+
+  if ((func != NULL) != ok) {
+    fprintf(stderr, "symbol_table: expected the checker to %s '%s'\n", ok ? "accept" : "reject", source);
+    failures++;
+  }
+
+  if (func) {
+    free_sem_func_storage(func);
+  }
+
+  free_arena(arena);
+}
+
+int main() {
+  init_thread();
+
+  // Names stay visible in nested blocks, so redeclaring one there clashes,
+  // and they are gone once their block is left.
+  expect_checked("{ a: int; { b: int; b = a; } { b: int; b = a; } }", true);
+  expect_checked("{ { a: int; } a: int; a = a; }", true);
+  expect_checked("{ a: int; { { a: int; } } }", false);
+  expect_checked("{ { a: int; } a = a; }", false);
+
+  // Place of each name, or SEM_NULL_PLACE while it is not visible.
+  SemPlace places[NUM_NAMES];
+  int visible[NUM_NAMES];
+  int num_visible = 0;
+
+  Vec(int) declared = NULL;
+  Vec(int) marks = NULL;
+  Vec(Copy) expected = NULL;
+
+  for (int i = 0; i < NUM_NAMES; ++i) {
+    places[i] = SEM_NULL_PLACE;
+  }
+
+  SemPlace next_place = 0;
+
+  emit("{\n");
+
+  for (int action = 0; action < NUM_ACTIONS || vec_len(marks); ++action) {
+    uint32_t roll = next_random() % 100;
+    bool closing = action >= NUM_ACTIONS;
+
+    if (!closing && roll < 35) {
+      int name = (int)(next_random() % NUM_NAMES);
+
+      // Mostly in nested blocks, so that leaving them deletes entries.
+      if (places[name] == SEM_NULL_PLACE && (vec_len(marks) || roll < 3)) {
+        places[name] = next_place++;
+        visible[num_visible++] = name;
+        vec_put(declared, name);
+        emit("n%d: int;\n", name);
+      }
+    }
+    else if (!closing && roll < 75) {
+      if (num_visible) {
+        int to = visible[next_random() % (uint32_t)num_visible];
+        int from = visible[next_random() % (uint32_t)num_visible];
+        vec_put(expected, ((Copy) { places[to], places[from] }));
+        emit("n%d = n%d;\n", to, from);
+      }
+    }
+    else if (!closing && roll < 88) {
+      if (vec_len(marks) < MAX_DEPTH) {
+        vec_put(marks, vec_len(declared));
+        emit("{\n");
+      }
+    }
+    else if (vec_len(marks)) {
+      int mark = vec_pop(marks);
+
+      while (vec_len(declared) > mark) {
+        int name = vec_pop(declared);
+        places[name] = SEM_NULL_PLACE;
+
+        for (int i = 0; i < num_visible; ++i) {
+          if (visible[i] == name) {
+            visible[i] = visible[--num_visible];
+            break;
+          }
+        }
+      }
+
+      emit("}\n");
+    }
+  }
+
+  emit("}\n");
+
+  Arena* arena = new_arena();
+  SemFunc* func = check_source(arena, text);
+
+  if (!func) {
+    fprintf(stderr, "symbol_table: the generated program was rejected\n");
+    return 1;
+  }
+
+  int num_copies = 0;
+
+  for (SemBlock* block = func->cfg; block; block = block->next) {
+    for (int i = 0; i < vec_len(block->code); ++i) {
+      SemInst* inst = &block->code[i];
+
+      if (inst->op != SEM_OP_COPY) {
+        continue;
+      }
+
+      if (num_copies >= vec_len(expected)) {
+        num_copies++;
+        continue;
+      }
+
+      Copy copy = expected[num_copies++];
+
+      if (inst->write != copy.write || inst->reads[0] != copy.read) {
+        fprintf(stderr, "symbol_table: copy %d is p%u = p%u, expected p%u = p%u\n", num_copies - 1, inst->write, inst->reads[0], copy.write, copy.read);
+        failures++;
+      }
+    }
+  }
+
+  if (num_copies != vec_len(expected)) {
+    fprintf(stderr, "symbol_table: %d copies, expected %d\n", num_copies, vec_len(expected));
+    failures++;
+  }
+
+  free_sem_func_storage(func);
+  free_arena(arena);
+
+  vec_free(declared);
+  vec_free(marks);
+  vec_free(expected);
+  free(text);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+
+#include "utility.h"
+#include "spindle/spindle.h"
+#include "spindle/internal.h"
+
+// Use lists under removal and re-adding. Every use must name an input slot
+// that holds its node, and that slot must know where the use sits.
+
+#define NUM_DEFS 8
+#define NUM_USERS 48
+
+static SB_Node* defs[NUM_DEFS];
+static SB_Node* users[NUM_USERS];
+
+static int failures;
+
+static void check(bool ok, SB_Node* node, const char* message) {
+  if (!ok) {
+    fprintf(stderr, "use_lists: n%d: %s\n", node->id, message);
+    failures++;
+  }
+}
+
+static void check_node(SB_Func* func, SB_Node* node) {
+  check(node->num_uses <= node->use_capacity, node, "more uses than capacity");
+
+  for (int32_t i = 0; i < node->num_uses; ++i) {
+    SB_Use* use = &node->uses[i];
+    SB_Node* user = sb_user(func, use);
+
+    check(user != NULL, node, "use names a dead node");
+
+    if (user) {
+      check(user->ins[use->index] == node->id, node, "use names an input that holds another node");
+      check(user->use_slots[use->index] == i, node, "input slot points at the wrong use");
+    }
+  }
+
+  for (int32_t i = 0; i < node->num_ins; ++i) {
+    SB_Node* input = sb_in(func, node, i);
+
+    if (!input) {
+      continue;
+    }
+
+    int32_t slot = node->use_slots[i];
+    check(slot < input->num_uses && input->uses[slot].user == node->id && input->uses[slot].index == i, node, "input has no matching use");
+  }
+}
+
+// Every live node in the table, not only the ones made here.
+static void check_all(SB_Func* func) {
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    SB_Node* node = func->nodes[id];
+
+    if (node) {
+      check(node->id == id, node, "table slot holds a node with another id");
+      check_node(func, node);
+    }
+  }
+}
+
+// The users are value numbered, so they leave the table before their
+// inputs change.
+static void detach(SB_Func* func, SB_Node* user, int32_t index) {
+  sb_forget_value(func, user);
+  sb_remove_use(func, user, index);
+  user->ins[index] = 0;
+}
+
+static void attach(SB_Func* func, SB_Node* user, int32_t index, SB_Node* def) {
+  user->ins[index] = def->id;
+  sb_add_use(func, def, user, index);
+}
+
+int main() {
+  init_thread();
+
+  SB_Context* ctx = sb_init();
+  SB_Func* func = sb_begin_func(ctx);
+
+  SB_Node* start = sb_node_start(func);
+
+  for (int i = 0; i < NUM_DEFS; ++i) {
+    defs[i] = sb_node_alloca(func);
+  }
+
+  // Enough users that every def outgrows its inline uses, and no two with
+  // the same inputs.
+  for (int i = 0; i < NUM_USERS; ++i) {
+    users[i] = sb_node_add(func, defs[i % NUM_DEFS], defs[i / NUM_DEFS]);
+  }
+
+  // Compaction needs an END to copy.
+  sb_node_end(func, sb_node_start_ctrl(func, start), sb_node_start_mem(func, start), users[1]);
+
+  check_all(func);
+
+  // Remove from the front, so the last use keeps moving into the hole.
+  for (int i = 0; i < NUM_USERS; ++i) {
+    if (users[i]->ins[0] == defs[0]->id) {
+      detach(func, users[i], 0);
+      check_all(func);
+    }
+  }
+
+  check(defs[0]->num_uses == NUM_DEFS, defs[0], "left over uses after removing every lhs use");
+
+  // Remove from the back, then re-add everything to another def.
+  for (int i = NUM_USERS; i-- > 0;) {
+    if (users[i]->ins[1] == defs[0]->id) {
+      detach(func, users[i], 1);
+      check_all(func);
+    }
+  }
+
+  check(defs[0]->num_uses == 0, defs[0], "left over uses after removing every use");
+
+  for (int i = 0; i < NUM_USERS; ++i) {
+    for (int32_t j = 0; j < 2; ++j) {
+      if (!users[i]->ins[j]) {
+        attach(func, users[i], j, defs[1]);
+      }
+    }
+  }
+
+  check_all(func);
+
+  // Move every other input around, which removes from the middle of lists.
+  for (int i = 0; i < NUM_USERS; i += 2) {
+    for (int32_t j = 0; j < 2; ++j) {
+      SB_Node* next = defs[(i + j + 1) % NUM_DEFS];
+
+      detach(func, users[i], j);
+      attach(func, users[i], j, next);
+      check_all(func);
+    }
+  }
+
+  int32_t total = 0;
+
+  for (int i = 0; i < NUM_DEFS; ++i) {
+    total += defs[i]->num_uses;
+  }
+
+  check(total == NUM_USERS * 2, defs[0], "use count does not match the number of inputs");
+
+  // Drop every third user and compact. The copies get dense ids and their
+  // use lists are rebuilt in fresh storage.
+  int num_killed = 0;
+
+  for (int i = 0; i < NUM_USERS; i += 3) {
+    detach(func, users[i], 0);
+    detach(func, users[i], 1);
+    sb_kill_node(func, users[i]);
+    num_killed++;
+  }
+
+  check_all(func);
+
+  int32_t num_live = func->num_live;
+  sb_compact_func(func);
+
+  check(func->next_id == num_live + 1, sb_func_start(func), "compaction left holes in the ids");
+  check_all(func);
+
+  total = 0;
+
+  for (int32_t id = 1; id < func->next_id; ++id) {
+    if (func->nodes[id]->kind == SB_NODE_ALLOCA) {
+      total += func->nodes[id]->num_uses;
+    }
+  }
+
+  check(total == (NUM_USERS - num_killed) * 2, sb_func_start(func), "compaction lost uses");
+
+  sb_cleanup(ctx);
+  cleanup_thread();
+
+  if (failures) {
+    fprintf(stderr, "use_lists: %d failures\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "utility.h"
+#include "front/front.h"
+#include "spindle/spindle.h"
+#include "spindle/internal.h"
+
+// Temps read only later in their own block become plain values, everything
+// else keeps an alloca under LOWER_MEMORY. The checker never reads a temp
+// in another block, so the test moves a definition up into the block
+// before it, which must cost the temp its value flag but not the result.
+
+#define SOURCE "{ a: int; b: int; a = 5; b = a - 5; if b { b = 1; } else { b = a * 2; } return b + 1; }"
+#define EXPECTED 11
+
+static int failures;
+
+static void expect(bool ok, const char* message) {
+  if (!ok) {
+    fprintf(stderr, "value_places: %s\n", message);
+    failures++;
+  }
+}
+
+static SemFunc* check_source(Arena* arena, Interner* interner) {
+  Tokens tokens = lex_source(arena, interner, "value_places", SOURCE, strlen(SOURCE));
+  ParseTree* tree = tokens.data ? parse(arena, tokens, "value_places", SOURCE) : NULL;
+  SemFunc* func = tree ? check_tree(arena, "value_places", SOURCE, tree) : NULL;
+
+  if (func && !sem_analyze_func("value_places", SOURCE, func)) {
+    return NULL;
+  }
+
+  return func;
+}
+
+static int count_allocas(SB_Func* func) {
+  int count = 0;
+
+  for (int32_t i = 0; i < func->next_id; ++i) {
+    SB_Node* node = func->nodes[i];
+    count += node && node->kind == SB_NODE_ALLOCA;
+  }
+
+  return count;
+}
+
+// Lowers 'func' and checks the number of allocas it starts out with and
+// what the optimized and scheduled code returns.
+static void expect_lowered(Arena* arena, SemFunc* func, LowerMode mode, int num_allocas, const char* message) {
+  SB_Context* sb = sb_init();
+  SB_Func* sb_func = lower_sem_func(sb, func, mode);
+
+  if (mode == LOWER_MEMORY) {
+    expect(count_allocas(sb_func) == num_allocas, message);
+  }
+
+  sb_opt(sb, sb_func);
+
+  SB_Schedule schedule = sb_schedule_func(arena, sb_func);
+  uint64_t result = 0;
+
+  expect(sb_run_schedule(sb_func, &schedule, &result) && result == EXPECTED, "the program returned the wrong value");
+}
+
+// Moves the first instruction of 'from' to the end of 'to', in front of the
+// branch into 'from'.
+static SemInst hoist_first_inst(SemBlock* from, SemBlock* to) {
+  SemInst inst = from->code[0];
+
+  memmove(from->code, from->code + 1, (size_t)(vec_len(from->code) - 1) * sizeof(SemInst));
+  vec_hdr(from->code)->length--;
+
+  SemInst branch = vec_pop(to->code);
+  vec_put(to->code, inst);
+  vec_put(to->code, branch);
+
+  return inst;
+}
+
+int main() {
+  init_thread();
+
+  Arena* arena = new_arena();
+  Interner* interner = new_interner();
+
+  SemFunc* func = check_source(arena, interner);
+
+  if (!func) {
+    fprintf(stderr, "value_places: the program was rejected\n");
+    return 1;
+  }
+
+  // As written every temp stays in its block, only 'a' and 'b' need memory.
+  bool all_values = true;
+
+  for (int i = 0; i < vec_len(func->place_data); ++i) {
+    uint32_t flags = func->place_data[i].flags;
+    all_values &= !(flags & SEM_PLACE_TEMP) == !(flags & SEM_PLACE_VALUE);
+  }
+
+  expect(all_values, "a temp used in its own block is not a value");
+
+  expect_lowered(arena, func, LOWER_MEMORY, 2, "expected an alloca for each declared local");
+  expect_lowered(arena, func, LOWER_SSA, 0, NULL);
+
+  // The then block starts with the constant 1 that is copied into 'b'.
+  SemBlock* entry = func->cfg;
+  SemInst* branch = vec_back(entry->code);
+  expect(branch->op == SEM_OP_BRANCH, "expected the entry block to end in the if's branch");
+
+  SemBlock* then_block = ((SemBlock**)branch->data)[0];
+  SemInst moved = hoist_first_inst(then_block, entry);
+
+  expect(moved.op == SEM_OP_INTEGER_CONST, "expected the then block to start with a constant");
+
+  sem_mark_value_places(func);
+
+  expect(func->place_data[moved.write].flags & SEM_PLACE_TEMP, "the moved result is not a temp");
+  expect(!(func->place_data[moved.write].flags & SEM_PLACE_VALUE), "a temp read in a successor block is still a value");
+
+  expect_lowered(arena, func, LOWER_MEMORY, 3, "expected an alloca for the temp read in a successor block");
+  expect_lowered(arena, func, LOWER_SSA, 0, NULL);
+
+  free_sem_func_storage(func);
+  free_interner(interner);
+  free_arena(arena);
+
+  cleanup_thread();
+
+  return failures ? 1 : 0;
+}